@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+"""DCT benchmark suite for tiny32-mc-acc.
+
+run:     builds main_printf.c variants, runs each one on the VP for every
+         hart count and generated input size and writes the results as JSON
+         (simulated time, per-hart instruction counts, mtime ticks of the
+         computation phase, host wall-clock and simulated MIPS, and the
+         PE/DMA counters of guests built with -DREPORT_PERF=1).
+compare: compares a result file against a stored baseline; simulated time
+         and instruction counts are deterministic, so any growth beyond the
+         tolerance is a regression and the exit status is 1.
+"""
+
+import argparse
+import json
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# variant name -> guest CFLAGS, every guest mode has one so that bench
+# runs it and checks its dct_out.txt against the first variant
+VARIANTS = {
+    "cpu": "-DSW_DCT=1",            # direct sum with cos(), no accelerator
+    "cpu-fast": "-DSW_DCT=2",       # Lee's fast DCT, no accelerator
+    "pe-memcpy": "-DUSE_DMA=0",     # PE jobs copied by the hart
+    "pe-dma": "-DUSE_DMA=1",        # PE jobs moved by the DMA
+    "pe-chain": "-DDMA_CHAIN=1",    # PE jobs of a coefficient in one DMA chain
+    "pe-batch": "-DPE_BATCH=1",     # PE jobs on the PE batch interface
+    "pe-coef": "-DPE_COEF=1",       # cosines from the PE coefficient table
+    "pe-dct": "-DPE_DCT=1",         # whole rows in the PE DCT mode
+    "pe-perf": "-DREPORT_PERF=1",   # pe-dma, reports the PE/DMA counters
+    "pe-pool": "-DPE_POOL=1",       # PE jobs through the shared PE pool
+    "pe-dma-spin": "-DDMA_IRQ=0",   # pe-dma, polls STATUS instead of wfi
+    # pe-dma, all harts share DMA channel 0 under the lock
+    "pe-dma-shared": "-DDMA_PER_HART=0",
+    "pe-stream": "-DDMA_STREAM=1",  # PE jobs streamed by the DMA
+    "pe-packed": "-DPE_PACKED=1",   # PE jobs in the packed Q format
+    # packed PE jobs streamed by the DMA
+    "pe-packed-stream": "-DPE_PACKED=1 -DDMA_STREAM=1",
+    # pe-memcpy, polls the PE STATUS before reading a result
+    "pe-poll": "-DUSE_DMA=0 -DPE_POLL=1",
+}
+
+# metrics that must not grow beyond the tolerance
+CHECKED = ("sim_ns", "instret_total", "compute_ticks")
+
+TIME_UNITS = {"fs": 1e-6, "ps": 1e-3, "ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def parse_size(text):
+    n, m = text.lower().split("x")
+    return int(n), int(m)
+
+
+def write_testcase(path, n, m, seed):
+    """n rows of m samples in the dct_testcase.txt format."""
+    rng = random.Random(seed)
+    with open(path, "w") as f:
+        f.write("%d %d\n" % (n, m))
+        for _ in range(n):
+            f.write("".join("%g " % rng.gauss(0.0, 1.0) for _ in range(m)) + "\n")
+
+
+def build(variant, cflags, out_dir):
+    # on the command line, so it wins over a CFLAGS inherited from make
+    flags = "CFLAGS=" + (cflags + " " + VARIANTS[variant]).strip()
+    subprocess.run(["make", "-s", "-B", "-C", HERE, "all", flags], check=True)
+    binary = os.path.join(out_dir, "main-" + variant)
+    shutil.copy(os.path.join(HERE, "main"), binary)
+    return binary
+
+
+def parse_output(text):
+    result = {}
+    m = re.search(r"simulation time: ([0-9.e+]+) (fs|ps|ns|us|ms|s)\b", text)
+    if m:
+        result["sim_ns"] = float(m.group(1)) * TIME_UNITS[m.group(2)]
+    result["instret"] = [int(x) for x in re.findall(r"num-instr = (\d+)", text)]
+    result["instret_total"] = sum(result["instret"])
+    m = re.search(r"computation: (\d+) mtime ticks", text)
+    if m:
+        result["compute_ticks"] = int(m.group(1))
+    # counter blocks printed by a -DREPORT_PERF=1 guest
+    perf = {}
+    for m in re.finditer(r"^(\w+): busy (\d+) idle (\d+) input-full (\d+) output-empty (\d+) ops (\d+) bytes (\d+)$",
+                         text, re.M):
+        perf[m.group(1)] = dict(zip(("busy", "idle", "input_full", "output_empty", "ops", "bytes"),
+                                    (int(x) for x in m.groups()[1:])))
+    if perf:
+        result["perf"] = perf
+    return result
+
+
+def read_output(path):
+    with open(path) as f:
+        return [float(x) for x in f.read().split()]
+
+
+def run(args):
+    vp = os.path.expanduser(args.vp)
+    work = os.path.abspath(args.work)
+    os.makedirs(work, exist_ok=True)
+
+    binaries = {v: build(v, args.cflags, work) for v in args.variants}
+    runs = []
+    for n, m in [parse_size(s) for s in args.sizes]:
+        reference = None
+        for variant in args.variants:
+            for harts in args.harts:
+                pes = args.pes or harts
+                run_dir = os.path.join(work, "%s-%dx%d-h%d" % (variant, n, m, harts))
+                os.makedirs(run_dir, exist_ok=True)
+                write_testcase(os.path.join(run_dir, "dct_testcase.txt"), n, m, args.seed)
+
+                cmd = [vp, "--intercept-syscalls", "--harts", str(harts), "--pes", str(pes)]
+                cmd += args.vp_flags.split() + [binaries[variant]]
+                start = time.monotonic()
+                proc = subprocess.run(cmd, cwd=run_dir, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                      universal_newlines=True)
+                wall = time.monotonic() - start
+                with open(os.path.join(run_dir, "vp.log"), "w") as f:
+                    f.write(proc.stdout)
+
+                entry = {"variant": variant, "harts": harts, "pes": pes, "n": n, "m": m,
+                         "exit": proc.returncode, "wall_s": round(wall, 3)}
+                entry.update(parse_output(proc.stdout))
+                entry["mips"] = round(entry["instret_total"] / wall / 1e6, 3) if wall > 0 else 0.0
+
+                # all variants compute the same transform, the first run of
+                # a size is the reference for the others
+                out = os.path.join(run_dir, "dct_out.txt")
+                if os.path.exists(out):
+                    values = read_output(out)
+                    if reference is None:
+                        reference = values
+                    elif len(values) == len(reference):
+                        entry["max_abs_err"] = max(abs(a - b) for a, b in zip(values, reference))
+
+                runs.append(entry)
+                print("%-10s %4dx%-4d harts %2d: %s" % (variant, n, m, harts, summary(entry)), flush=True)
+
+    with open(args.output, "w") as f:
+        json.dump({"vp": vp, "cflags": args.cflags, "seed": args.seed, "runs": runs}, f, indent=1)
+        f.write("\n")
+    return 1 if any(r["exit"] != 0 for r in runs) else 0
+
+
+def summary(entry):
+    if entry["exit"] != 0:
+        return "FAILED (exit %d)" % entry["exit"]
+    return "%.0f ns, %d instr, %s ticks, %.2f s wall, %.2f MIPS" % (
+        entry.get("sim_ns", 0), entry["instret_total"], entry.get("compute_ticks", "-"), entry["wall_s"],
+        entry["mips"])
+
+
+def key(entry):
+    return (entry["variant"], entry["harts"], entry["pes"], entry["n"], entry["m"])
+
+
+def compare(args):
+    with open(args.baseline) as f:
+        baseline = {key(r): r for r in json.load(f)["runs"]}
+    with open(args.results) as f:
+        results = json.load(f)["runs"]
+
+    regressions = 0
+    for r in results:
+        name = "%s %dx%d harts %d" % (r["variant"], r["n"], r["m"], r["harts"])
+        b = baseline.get(key(r))
+        if b is None:
+            print("%-32s new" % name)
+            continue
+        if r["exit"] != 0:
+            print("%-32s FAILED (exit %d)" % (name, r["exit"]))
+            regressions += 1
+            continue
+        changes = []
+        for metric in CHECKED:
+            if metric not in r or not b.get(metric):
+                continue
+            delta = (r[metric] - b[metric]) / b[metric] * 100.0
+            mark = ""
+            if delta > args.tolerance:
+                mark = " REGRESSION"
+                regressions += 1
+            changes.append("%s %+.2f%%%s" % (metric, delta, mark))
+        if b.get("wall_s"):
+            changes.append("wall %+.1f%%" % ((r["wall_s"] - b["wall_s"]) / b["wall_s"] * 100.0))
+        print("%-32s %s" % (name, ", ".join(changes)))
+
+    print("%d regression(s) beyond %.2f%%" % (regressions, args.tolerance))
+    return 1 if regressions else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command")
+
+    p = sub.add_parser("run", help="build and run the benchmarks")
+    p.add_argument("--vp", default="~/ee6470/riscv-vp/vp/build/bin/tiny32-mc-acc")
+    p.add_argument("--vp-flags", default="", help="extra VP options for every run")
+    p.add_argument("--cflags", default="", help="extra guest CFLAGS for every variant")
+    p.add_argument("--variants", nargs="+", default=list(VARIANTS), choices=list(VARIANTS),
+                   help="variants to run, default all; the first one is the max_abs_err reference")
+    p.add_argument("--harts", nargs="+", type=int, default=[1, 2, 4])
+    p.add_argument("--pes", type=int, default=0, help="PEs per run, default one per hart")
+    p.add_argument("--sizes", nargs="+", default=["16x8", "32x16", "64x32"], help="input rows x row length")
+    p.add_argument("--seed", type=int, default=6470)
+    p.add_argument("--work", default=os.path.join(HERE, "bench_runs"))
+    p.add_argument("-o", "--output", default="bench.json")
+
+    p = sub.add_parser("compare", help="compare results against a baseline")
+    p.add_argument("baseline")
+    p.add_argument("results")
+    p.add_argument("--tolerance", type=float, default=1.0, help="allowed growth in percent")
+
+    args = parser.parse_args()
+    if args.command == "run":
+        return run(args)
+    if args.command == "compare":
+        return compare(args)
+    parser.print_help()
+    return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main())
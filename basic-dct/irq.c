@@ -9,8 +9,26 @@
 
 #define PLIC_BASE 0x40000000
 #define IRQ_TABLE_NUM_ENTRIES 64
-static volatile uint32_t * const PLIC_INTERRUPT_ENABLE_START = (uint32_t * const)(PLIC_BASE + 0x2000);
-static volatile uint32_t * const PLIC_CLAIM_AND_RESPONSE_REGISTER = (uint32_t * const)(PLIC_BASE + 0x200004);
+// every hart has its own PLIC context: enable bits and claim/complete
+// register of hart h are at these offsets plus h times the stride
+#define PLIC_INTERRUPT_ENABLE_START 0x2000
+#define PLIC_INTERRUPT_ENABLE_STRIDE 0x80
+#define PLIC_CLAIM_AND_RESPONSE_REGISTER 0x200004
+#define PLIC_CONTEXT_STRIDE 0x1000
+
+static inline uint32_t hart_id() {
+	uint32_t id;
+	asm volatile ("csrr %0, mhartid" : "=r" (id));
+	return id;
+}
+
+static volatile uint32_t *plic_enable(uint32_t hart) {
+	return (volatile uint32_t *)(PLIC_BASE + PLIC_INTERRUPT_ENABLE_START + hart * PLIC_INTERRUPT_ENABLE_STRIDE);
+}
+
+static volatile uint32_t *plic_claim(uint32_t hart) {
+	return (volatile uint32_t *)(PLIC_BASE + PLIC_CLAIM_AND_RESPONSE_REGISTER + hart * PLIC_CONTEXT_STRIDE);
+}
 
 
 static void irq_empty_handler() {}
@@ -31,11 +49,12 @@ void level_1_interrupt_handler(uint32_t cause) {
 		case RISCV_MACHINE_EXTERNAL_INTERRUPT: {
 			asm volatile ("csrc mip, %0" : : "r" (0x800));
 
-			uint32_t irq_id = *PLIC_CLAIM_AND_RESPONSE_REGISTER;
+			volatile uint32_t *claim = plic_claim(hart_id());
+			uint32_t irq_id = *claim;
 
 			irq_handler_table[irq_id]();
 
-			*PLIC_CLAIM_AND_RESPONSE_REGISTER = 1;
+			*claim = irq_id;
 
 			return;
 		}
@@ -57,10 +76,12 @@ void level_1_interrupt_handler(uint32_t cause) {
 	assert (0 && "unsupported cause");
 }
 
+// Routes irq_id to the calling hart only. Enable registers are not
+// shared between harts, so no locking is needed.
 void register_interrupt_handler(uint32_t irq_id, irq_handler_t fn) {
 	assert (irq_id < IRQ_TABLE_NUM_ENTRIES);
 	// enable interrupt
-	volatile uint32_t* const reg = (PLIC_INTERRUPT_ENABLE_START + irq_id/32);
+	volatile uint32_t* const reg = (plic_enable(hart_id()) + irq_id/32);
 	*reg |= 1 << (irq_id%32);
 	// set a prio different to zero (which means do-not-interrupt)
 	*((uint32_t*) (PLIC_BASE + irq_id*sizeof(uint32_t))) = 1;
@@ -70,3 +91,19 @@ void register_interrupt_handler(uint32_t irq_id, irq_handler_t fn) {
 void register_timer_interrupt_handler(irq_handler_t fn) {
 	timer_irq_handler = fn;
 }
+
+void enable_external_interrupts(void) {
+	asm volatile ("csrs mie, %0" : : "r" (0x800));  // MEIE
+	asm volatile ("csrsi mstatus, 0x8");             // MIE
+}
+
+void wait_for_interrupt(volatile uint32_t* flag) {
+	while (1) {
+		asm volatile ("csrci mstatus, 0x8");
+		if (*flag)
+			break;
+		asm volatile ("wfi");
+		asm volatile ("csrsi mstatus, 0x8");  // take the interrupt
+	}
+	asm volatile ("csrsi mstatus, 0x8");
+}
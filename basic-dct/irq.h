@@ -9,6 +9,14 @@ void register_interrupt_handler(uint32_t irq_id, irq_handler_t fn);
 
 void register_timer_interrupt_handler(irq_handler_t fn);
 
+// set MEIE and MIE of the calling hart
+void enable_external_interrupts(void);
+
+// Sleeps in wfi until a handler has set *flag. Interrupts are masked
+// between checking the flag and wfi, a pending interrupt still ends wfi
+// and is taken right after, so no wakeup is lost.
+void wait_for_interrupt(volatile uint32_t* flag);
+
 extern volatile uint64_t* mtime;
 extern volatile uint64_t* mtimecmp;
 
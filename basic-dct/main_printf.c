@@ -4,40 +4,285 @@
 #include "string.h"
 #include "math.h"
 #include "stdint.h"
-// #include "irq.h"
+#include "irq.h"
 
 #define PI 3.1415926535097
 
-// Sobel Filter ACC
-static char* const PE1_START_ADDR   = (char* const)0x03000000;
-static char* const PE1_OUTPUT_ADDR  = (char* const)0x0300000c;
-static char* const PE2_START_ADDR   = (char* const)0x03100000;
-static char* const PE2_OUTPUT_ADDR  = (char* const)0x0310000c;
-
-// DMA 
-static volatile uint32_t * const DMA_SRC_ADDR  = (uint32_t * const)0x70000000;
-static volatile uint32_t * const DMA_DST_ADDR  = (uint32_t * const)0x70000004;
-static volatile uint32_t * const DMA_LEN_ADDR  = (uint32_t * const)0x70000008;
-static volatile uint32_t * const DMA_OP_ADDR   = (uint32_t * const)0x7000000C;
-static volatile uint32_t * const DMA_STAT_ADDR = (uint32_t * const)0x70000010;
+// VP config ROM, word indices. The PE address map is generated from the
+// --pes option: PE i is at PE_BASE + i * PE_STRIDE, followed by the
+// reduced (12 bit, 5 stages) and extended (24 bit, 16 stages) precision PEs.
+static volatile uint32_t * const CONFIG_ROM = (uint32_t * const)0x02020000;
+#define CONFIG_HARTS      1
+#define CONFIG_PES        2
+#define CONFIG_PE_BASE    3
+#define CONFIG_PE_STRIDE  4
+#define CONFIG_PE_LP_BASE 6
+#define CONFIG_PE_HP_BASE 7
+#define CONFIG_DMA_IRQ    9   // completion interrupt of hart h is DMA_IRQ + h
+#define CONFIG_POOL_BASE  10
+#define MAX_PROCESSORS    16
+
+// PE result registers, offset from the PE base address
+#define PE_OUTPUT        0x0c
+
+// PE pool: one port per hart at POOL_BASE + POOL_PORT + hart * POOL_PORT_STRIDE,
+// word indices of the port registers. Writing Z submits {TAG, A, B, Z},
+// reading RESULT pops the next completed job of the port ({tag, a, b, z}).
+#define POOL_PORT        0x1000
+#define POOL_PORT_STRIDE 0x40
+#define POOL_TAG         0
+#define POOL_A           1
+#define POOL_B           2
+#define POOL_Z           3
+#define POOL_RESULT      8
+#define POOL_PORT_DEPTH  64
+#define POOL_PERF        0x100
+
+// DMA channels, word indices of the channel registers. Channel c has its
+// register bank at DMA_CHANNEL + c * DMA_CHANNEL_STRIDE, the register set
+// at the DMA base is channel 0 as well. A hart with a channel of its own
+// issues transfers without a lock.
+static volatile uint32_t * const DMA_ADDR = (uint32_t * const)0x70000000;
+#define DMA_SRC             0
+#define DMA_DST             1
+#define DMA_LEN             2
+#define DMA_OP              3
+#define DMA_STAT            4
+#define DMA_DESC            5
+#define DMA_STATUS          6
+#define DMA_HART            7
+#define DMA_CHANNELS        11  // number of channels, at the DMA base only
+#define DMA_CHANNEL         0x400
+#define DMA_CHANNEL_STRIDE  0x40
 static const uint32_t DMA_OP_NOP = 0;
 static const uint32_t DMA_OP_MEMCPY = 1;
+static const uint32_t DMA_OP_MEMSET = 2;
+static const uint32_t DMA_OP_STREAM = 6;
+static const uint32_t DMA_DESC_IRQ = 1;
+#define DMA_DESC_HART_SHIFT 8
+static const uint32_t DMA_STATUS_BUSY = 0x1;
+static const uint32_t DMA_STATUS_ERROR = 0x4;
+
+// PE poll interface, offset from the PE base address: STATUS never blocks,
+// the result registers do not either once it reports a result
+#define PE_STATUS        0x60
+static const uint32_t PE_STATUS_RESULT = 0x1;
+
+// PE packed job window, offsets from the PE base address: a and b as Q8.8
+// in one word (a in bits 15..0), z as Q9.7 in a half-word, 6 bytes per
+// job and direction
+#define PE_PACKED_AB     0x50
+#define PE_PACKED_Z      0x54
+#define PE_PACKED_OUT_AB 0x58
+#define PE_PACKED_OUT_Z  0x5c
+#define PE_Q_DATA_FRAC   8
+#define PE_Q_ANGLE_FRAC  7
+
+// PE batch interface, offsets from the PE base address
+#define PE_BATCH_COUNT   0x20
+#define PE_BATCH_START   0x24
+#define PE_BATCH_STATUS  0x28
+#define PE_BATCH_IN      0x1000
+#define PE_BATCH_OUT     0x4000
+#define PE_BATCH_DEPTH   256
+static const uint32_t PE_BATCH_GO = 0x1;
+static const uint32_t PE_BATCH_DONE = 0x2;
+
+// PE DCT mode, offsets from the PE base address, START/STATUS use the
+// PE_BATCH_* bits
+#define PE_DCT_LEN       0x30
+#define PE_DCT_START     0x34
+#define PE_DCT_STATUS    0x38
+#define PE_DCT_IN        0x7000
+#define PE_DCT_OUT       0x8000
+#define PE_DCT_MAX_LEN   256
+
+// PE DCT coefficient table, offsets from the PE base address, STATUS uses
+// the PE_BATCH_* bits
+#define PE_COEF_M        0x40
+#define PE_COEF_STATUS   0x44
+#define PE_COEF_INDEX    0x48
+#define PE_COEF_VALUE    0x4c
+#define PE_COEF_MAX_M    1024
 
-int _is_using_dma = 1;
-// volatile int dma_completed = 0;
+// performance counter blocks of the PEs (offset from the PE base address)
+// and of the DMA, word indices of the counters
+#define PE_PERF          0x100
+static volatile uint32_t * const DMA_PERF_ADDR = (uint32_t * const)0x70000100;
+#define PERF_CTRL        0
+#define PERF_BUSY        1
+#define PERF_IDLE        2
+#define PERF_IN_FULL     3
+#define PERF_OUT_EMPTY   4
+#define PERF_OPS         5
+#define PERF_BYTES       6
+static const uint32_t PERF_RESET = 0x1;
+static const uint32_t PERF_FREEZE = 0x2;
+
+// scatter-gather descriptor, walked by the DMA channel starting at DESC
+typedef struct dma_desc {
+	uint32_t src;
+	uint32_t dst;
+	uint32_t len;
+	uint32_t op;
+	uint32_t flags;
+	uint32_t next;
+} dma_desc_t;
+
+// OP_STREAM descriptor: the tail loads the DMA STREAM_IN/OUT/ITEM registers
+typedef struct dma_stream_desc {
+	dma_desc_t desc;
+	uint32_t in;
+	uint32_t out;
+	uint32_t item;
+} dma_stream_desc_t;
+
+// PE job in the packed format, as laid out in the packed window
+typedef struct packed_job {
+	int16_t a;
+	int16_t b;
+	int16_t z;
+} packed_job_t;
+
+// PE pool job as submitted to a port in one 16-byte write
+typedef struct pool_job {
+	uint32_t tag;
+	float abz[3];
+} pool_job_t;
+
+// Partition the output rows between the harts, lock free. 0 selects the
+// original kernel that splits the sum over k between the harts and
+// accumulates under a global lock. Both produce the same dct_out.txt.
+#ifndef ROW_PARTITION
+#define ROW_PARTITION 1
+#endif
+int _is_using_row_partition = ROW_PARTITION;
+// Software DCT instead of the PE, the CPU baseline for the accelerator
+// modes: SW_DCT_DIRECT is the direct sum with a cos() per term,
+// SW_DCT_FAST Lee's recursive factorization with precomputed twiddles
+// (lengths that are no power of two use a precomputed cosine table).
+#define SW_DCT_OFF    0
+#define SW_DCT_DIRECT 1
+#define SW_DCT_FAST   2
+#ifndef SW_DCT
+#define SW_DCT SW_DCT_OFF
+#endif
+int _is_using_sw_dct = SW_DCT;
+// separable 2D DCT: transform the columns of the row transform, in the PE
+// DCT mode if the rows use it and in software otherwise
+#ifndef DCT_2D
+#define DCT_2D 0
+#endif
+int _is_using_2d = DCT_2D;
+// move PE operands and results on the DMA, 0 copies them with the CPU
+#ifndef USE_DMA
+#define USE_DMA 1
+#endif
+int _is_using_dma = USE_DMA;
+// queue all PE jobs of one output coefficient as a single descriptor chain
+#ifndef DMA_CHAIN
+#define DMA_CHAIN 0
+#endif
+int _is_using_dma_chain = DMA_CHAIN;
+// run all PE jobs of one output coefficient on the PE batch interface
+#ifndef PE_BATCH
+#define PE_BATCH 0
+#endif
+int _is_using_pe_batch = PE_BATCH;
+// move PE jobs in the packed Q format instead of floats, for the per-job
+// path and the DMA stream
+#ifndef PE_PACKED
+#define PE_PACKED 0
+#endif
+int _is_using_pe_packed = PE_PACKED;
+// stream all PE jobs of one output coefficient through the PE on the DMA,
+// paced by the PE fifo levels
+#ifndef DMA_STREAM
+#define DMA_STREAM 0
+#endif
+int _is_using_dma_stream = DMA_STREAM;
+// run all PE jobs of one output coefficient through the shared PE pool,
+// which spreads them over all PEs
+#ifndef PE_POOL
+#define PE_POOL 0
+#endif
+int _is_using_pe_pool = PE_POOL;
+// transform whole rows in the PE DCT mode, rows are split between the harts
+#ifndef PE_DCT
+#define PE_DCT 0
+#endif
+int _is_using_pe_dct = PE_DCT;
+// read cos(180 (k + 0.5) j / m) from the PE coefficient table instead of
+// sending the phase for every (i, j, k)
+#ifndef PE_COEF
+#define PE_COEF 0
+#endif
+int _is_using_pe_coef = PE_COEF;
+// poll the PE STATUS register before reading a result on the CPU path,
+// so the hart never waits inside a bus access
+#ifndef PE_POLL
+#define PE_POLL 0
+#endif
+int _is_using_pe_poll = PE_POLL;
+// print the PE and DMA counters for the computation phase
+#ifndef REPORT_PERF
+#define REPORT_PERF 0
+#endif
+int _is_reporting_perf = REPORT_PERF;
+// print the mtime ticks hart 0 spends in the computation phase
+int _is_reporting_time = 1;
+// sleep in wfi until the DMA completion interrupt instead of polling
+#ifndef DMA_IRQ
+#define DMA_IRQ 1
+#endif
+int _is_using_dma_irq = DMA_IRQ;
+// give every hart its own DMA channel, 0 shares channel 0 under the lock
+#ifndef DMA_PER_HART
+#define DMA_PER_HART 1
+#endif
+int _is_using_dma_channels = DMA_PER_HART;
+// set by the DMA completion interrupt of each hart
+volatile uint32_t dma_completed[MAX_PROCESSORS];
+// number of DMA channels, read by every hart at start up
+uint32_t dma_channels = 1;
 
 union pack {
   float f[3];
   unsigned char uc[12];
 };
 
-// void dma_irq_handler() {
-// 	dma_completed = 1;
-// }
+uint32_t current_hart() {
+	uint32_t hart;
+	__asm__ __volatile__("csrr %0, mhartid" : "=r"(hart));
+	return hart;
+}
+
+void dma_irq_handler() {
+	dma_completed[current_hart()] = 1;
+}
+
+// Registers of the DMA channel of hart, channel 0 if it has none.
+volatile uint32_t* dma_channel(uint32_t hart) {
+	if (!_is_using_dma_channels || hart >= dma_channels) return DMA_ADDR;
+	return (volatile uint32_t*)((char*)DMA_ADDR + DMA_CHANNEL + hart * DMA_CHANNEL_STRIDE);
+}
+
+// Whether some of the harts share channel 0, so programming SRC/DST/LEN
+// and starting the operation has to happen under the lock.
+int dma_channel_shared(uint32_t harts) {
+	return !_is_using_dma_channels || harts > dma_channels;
+}
 
-// void init() {
-// 	register_interrupt_handler(4, dma_irq_handler);
-// }
+// Start the operation programmed in SRC/DST/LEN on behalf of this hart
+// and wait for it, asleep until the completion interrupt or polling STATUS.
+void dma_start_and_wait(volatile uint32_t* dma, uint32_t op) {
+	uint32_t hart = current_hart();
+	dma_completed[hart] = 0;
+	dma[DMA_HART] = hart;
+	dma[DMA_OP] = op;
+	if (_is_using_dma_irq) wait_for_interrupt(&dma_completed[hart]);
+	else while (dma[DMA_STATUS] & DMA_STATUS_BUSY);
+}
 
 
 int sem_init (uint32_t *__sem, uint32_t count) __THROW
@@ -96,14 +341,11 @@ int barrier(uint32_t *__sem, uint32_t *__lock, uint32_t *counter, uint32_t threa
 void write_data_to_ACC(char* ADDR, unsigned char* buffer, int len){
   if(_is_using_dma){  
     // Using DMA 
-	// dma_completed = 0;
-    *DMA_SRC_ADDR = (uint32_t)(buffer);
-    *DMA_DST_ADDR = (uint32_t)(ADDR);
-    *DMA_LEN_ADDR = len;
-    *DMA_OP_ADDR  = DMA_OP_MEMCPY;
-	// while (!dma_completed) {
-	// 	asm volatile ("wfi");
-	// }
+    volatile uint32_t* dma = dma_channel(current_hart());
+    dma[DMA_SRC] = (uint32_t)(buffer);
+    dma[DMA_DST] = (uint32_t)(ADDR);
+    dma[DMA_LEN] = len;
+    dma_start_and_wait(dma, DMA_OP_MEMCPY);
   }else{
     // Directly Send
     memcpy(ADDR, buffer, sizeof(unsigned char)*len);
@@ -112,20 +354,285 @@ void write_data_to_ACC(char* ADDR, unsigned char* buffer, int len){
 void read_data_from_ACC(char* ADDR, unsigned char* buffer, int len){
   if(_is_using_dma){
     // Using DMA 
-	// dma_completed = 0;
-    *DMA_SRC_ADDR = (uint32_t)(ADDR);
-    *DMA_DST_ADDR = (uint32_t)(buffer);
-    *DMA_LEN_ADDR = len;
-    *DMA_OP_ADDR  = DMA_OP_MEMCPY;
-	// while (!dma_completed) {
-	// 	asm volatile ("wfi");
-	// }
+    volatile uint32_t* dma = dma_channel(current_hart());
+    dma[DMA_SRC] = (uint32_t)(ADDR);
+    dma[DMA_DST] = (uint32_t)(buffer);
+    dma[DMA_LEN] = len;
+    dma_start_and_wait(dma, DMA_OP_MEMCPY);
   }else{
     // Directly Read
     memcpy(buffer, ADDR, sizeof(unsigned char)*len);
   }
 }
 
+static const uint32_t dma_chain_done_value = 1;
+
+// Terminate a chain with a descriptor that sets *done and interrupts
+// this hart.
+void dma_set_done_desc(dma_desc_t* desc, volatile uint32_t* done) {
+	desc->src = (uint32_t)(&dma_chain_done_value);
+	desc->dst = (uint32_t)(done);
+	desc->len = 4;
+	desc->op = DMA_OP_MEMCPY;
+	desc->flags = DMA_DESC_IRQ | (current_hart() << DMA_DESC_HART_SHIFT);
+	desc->next = 0;
+}
+
+void dma_run_chain(dma_desc_t* head, volatile uint32_t* done) {
+	*done = 0;
+	dma_channel(current_hart())[DMA_DESC] = (uint32_t)(head);
+	if (_is_using_dma_irq) wait_for_interrupt(done);
+	else while (!*done);
+}
+
+// Run count PE jobs through one descriptor chain: for every job the
+// operands are copied to the PE and the result back into jobs[l], the
+// last descriptor sets *done. Costs a single MMIO write.
+void run_jobs_by_dma_chain(char* PE_IN, char* PE_OUT, union pack* jobs, int count, dma_desc_t* desc, volatile uint32_t* done) {
+	int d = 0;
+	for (int l = 0; l < count; l++) {
+		desc[d].src = (uint32_t)(jobs[l].uc);
+		desc[d].dst = (uint32_t)(PE_IN);
+		desc[d].len = 12;
+		desc[d].op = DMA_OP_MEMCPY;
+		desc[d].flags = 0;
+		desc[d].next = (uint32_t)(&desc[d + 1]);
+		d++;
+		desc[d].src = (uint32_t)(PE_OUT);
+		desc[d].dst = (uint32_t)(jobs[l].uc);
+		desc[d].len = 12;
+		desc[d].op = DMA_OP_MEMCPY;
+		desc[d].flags = 0;
+		desc[d].next = (uint32_t)(&desc[d + 1]);
+		d++;
+	}
+	dma_set_done_desc(&desc[d], done);
+	dma_run_chain(desc, done);
+}
+
+// Copy len bytes on the DMA and wait for it.
+void dma_memcpy(void* dst, const void* src, uint32_t len) {
+	dma_desc_t desc[2];
+	volatile uint32_t done;
+	desc[0].src = (uint32_t)(src);
+	desc[0].dst = (uint32_t)(dst);
+	desc[0].len = len;
+	desc[0].op = DMA_OP_MEMCPY;
+	desc[0].flags = 0;
+	desc[0].next = (uint32_t)(&desc[1]);
+	dma_set_done_desc(&desc[1], &done);
+	dma_run_chain(desc, &done);
+}
+
+// Fill len bytes at dst with value on the DMA and wait for it.
+void dma_memset(void* dst, uint8_t value, uint32_t len) {
+	dma_desc_t desc[2];
+	volatile uint32_t done;
+	desc[0].src = value;
+	desc[0].dst = (uint32_t)(dst);
+	desc[0].len = len;
+	desc[0].op = DMA_OP_MEMSET;
+	desc[0].flags = 0;
+	desc[0].next = (uint32_t)(&desc[1]);
+	dma_set_done_desc(&desc[1], &done);
+	dma_run_chain(desc, &done);
+}
+
+// Run count PE jobs of item bytes each as one DMA stream: the DMA feeds
+// the operands to PE_IN whenever the PE input fifos have room and stores
+// the results from PE_OUT over the operands as they come out (result l is
+// written after operand l was read), then interrupts this hart. Costs a
+// single MMIO write.
+void run_jobs_by_dma_stream(char* PE_IN, char* PE_OUT, void* jobs, int count, int item) {
+	dma_stream_desc_t stream;
+	dma_desc_t done_desc;
+	volatile uint32_t done;
+	stream.desc.src = (uint32_t)(jobs);
+	stream.desc.dst = (uint32_t)(jobs);
+	stream.desc.len = count * item;
+	stream.desc.op = DMA_OP_STREAM;
+	stream.desc.flags = 0;
+	stream.desc.next = (uint32_t)(&done_desc);
+	stream.in = (uint32_t)(PE_IN);
+	stream.out = (uint32_t)(PE_OUT);
+	stream.item = item;
+	dma_set_done_desc(&done_desc, &done);
+	dma_run_chain(&stream.desc, &done);
+}
+
+// Run count PE jobs on the PE batch interface: operands into the PE
+// SRAM, START, wait for DONE and copy the results back into jobs.
+void run_jobs_by_pe_batch(char* PE_BASE, union pack* jobs, int count) {
+	volatile uint32_t* count_reg = (volatile uint32_t*)(PE_BASE + PE_BATCH_COUNT);
+	volatile uint32_t* start_reg = (volatile uint32_t*)(PE_BASE + PE_BATCH_START);
+	volatile uint32_t* status_reg = (volatile uint32_t*)(PE_BASE + PE_BATCH_STATUS);
+	while (count > 0) {
+		int chunk = count < PE_BATCH_DEPTH ? count : PE_BATCH_DEPTH;
+		if (_is_using_dma) dma_memcpy(PE_BASE + PE_BATCH_IN, jobs, chunk * 12);
+		else memcpy(PE_BASE + PE_BATCH_IN, jobs, chunk * 12);
+		*count_reg = chunk;
+		*start_reg = PE_BATCH_GO;
+		while (!(*status_reg & PE_BATCH_DONE));
+		if (_is_using_dma) dma_memcpy(jobs, PE_BASE + PE_BATCH_OUT, chunk * 12);
+		else memcpy(jobs, PE_BASE + PE_BATCH_OUT, chunk * 12);
+		jobs += chunk;
+		count -= chunk;
+	}
+}
+
+// Run count PE jobs through a PE pool port, POOL_PORT_DEPTH at a time.
+// Jobs are tagged with their index and may complete out of order on
+// different PEs, the results are put back in place. With the DMA every
+// chunk is submitted by one descriptor chain of 16-byte job records.
+void run_jobs_by_pe_pool(volatile uint32_t* port, union pack* jobs, int count, pool_job_t* records, dma_desc_t* desc) {
+	volatile float* port_f = (volatile float*)port;
+	volatile uint32_t done;
+	while (count > 0) {
+		int chunk = count < POOL_PORT_DEPTH ? count : POOL_PORT_DEPTH;
+		for (int l = 0; l < chunk; l++) {
+			if (_is_using_dma) {
+				records[l].tag = l;
+				for (int c = 0; c < 3; c++) records[l].abz[c] = jobs[l].f[c];
+				desc[l].src = (uint32_t)(&records[l]);
+				desc[l].dst = (uint32_t)(&port[POOL_TAG]);
+				desc[l].len = sizeof(pool_job_t);
+				desc[l].op = DMA_OP_MEMCPY;
+				desc[l].flags = 0;
+				desc[l].next = (uint32_t)(&desc[l + 1]);
+			} else {
+				port[POOL_TAG] = l;
+				port_f[POOL_A] = jobs[l].f[0];
+				port_f[POOL_B] = jobs[l].f[1];
+				port_f[POOL_Z] = jobs[l].f[2];
+			}
+		}
+		if (_is_using_dma) {
+			dma_set_done_desc(&desc[chunk], &done);
+			dma_run_chain(desc, &done);
+		}
+		for (int l = 0; l < chunk; l++) {
+			uint32_t tag = port[POOL_RESULT];
+			for (int c = 0; c < 3; c++) jobs[tag].f[c] = port_f[POOL_RESULT + 1 + c];
+		}
+		jobs += chunk;
+		count -= chunk;
+	}
+}
+
+// Orthonormal DCT of one row of m samples in the PE DCT mode.
+void run_row_by_pe_dct(char* PE_BASE, float* in, float* out, int m) {
+	volatile uint32_t* len_reg = (volatile uint32_t*)(PE_BASE + PE_DCT_LEN);
+	volatile uint32_t* start_reg = (volatile uint32_t*)(PE_BASE + PE_DCT_START);
+	volatile uint32_t* status_reg = (volatile uint32_t*)(PE_BASE + PE_DCT_STATUS);
+	if (_is_using_dma) dma_memcpy(PE_BASE + PE_DCT_IN, in, m * sizeof(float));
+	else memcpy(PE_BASE + PE_DCT_IN, in, m * sizeof(float));
+	*len_reg = m;
+	*start_reg = PE_BATCH_GO;
+	while (!(*status_reg & PE_BATCH_DONE));
+	if (_is_using_dma) dma_memcpy(out, PE_BASE + PE_DCT_OUT, m * sizeof(float));
+	else memcpy(out, PE_BASE + PE_DCT_OUT, m * sizeof(float));
+}
+
+// Let the PE fill its coefficient table for length m.
+void pe_coef_init(char* PE_BASE, int m) {
+	volatile uint32_t* m_reg = (volatile uint32_t*)(PE_BASE + PE_COEF_M);
+	volatile uint32_t* status_reg = (volatile uint32_t*)(PE_BASE + PE_COEF_STATUS);
+	*m_reg = m;
+	while (!(*status_reg & PE_BATCH_DONE));
+}
+
+float pe_coef(char* PE_BASE, int k, int j) {
+	volatile uint32_t* index_reg = (volatile uint32_t*)(PE_BASE + PE_COEF_INDEX);
+	volatile float* value_reg = (volatile float*)(PE_BASE + PE_COEF_VALUE);
+	*index_reg = ((uint32_t)j << 16) | (uint32_t)k;
+	return *value_reg;
+}
+
+// Tables of the software DCT for one length
+typedef struct sw_dct {
+	int len;
+	int fast;        // len is a power of two
+	float* twiddle;  // 1 / (2 cos(pi (i + 0.5) / (2 h))) at [h + i], h = 1, 2, .., len / 2
+	float* cosines;  // cos(pi (k + 0.5) j / len) at [j * len + k]
+} sw_dct_t;
+
+void sw_dct_init(sw_dct_t* t, int len) {
+	t->len = len;
+	t->fast = len > 0 && (len & (len - 1)) == 0;
+	t->twiddle = 0;
+	t->cosines = 0;
+	if (t->fast) {
+		t->twiddle = malloc(len * sizeof(float));
+		for (int h = 1; h < len; h = 2 * h) {
+			for (int i = 0; i < h; ++i) t->twiddle[h + i] = 1.0 / (2.0 * cos(PI * (i + 0.5) / (2 * h)));
+		}
+	} else {
+		t->cosines = malloc(len * len * sizeof(float));
+		for (int j = 0; j < len; ++j) {
+			for (int k = 0; k < len; ++k) t->cosines[j * len + k] = cos(PI * (k + 0.5) * j / len);
+		}
+	}
+}
+
+// Lee's DCT-II in place, X[j] = sum_k x[k] cos(pi (k + 0.5) j / N) for N
+// a power of two: the sums x[i] + x[N-1-i] give the even outputs, the
+// differences scaled by the twiddles the odd ones after adding
+// neighbouring outputs. tmp holds N floats.
+void lee_dct(float* x, float* tmp, int N, const float* twiddle) {
+	if (N == 1) return;
+	int h = N / 2;
+	for (int i = 0; i < h; ++i) {
+		float a = x[i];
+		float b = x[N - 1 - i];
+		tmp[i] = a + b;
+		tmp[i + h] = (a - b) * twiddle[h + i];
+	}
+	lee_dct(tmp, x, h, twiddle);
+	lee_dct(tmp + h, x, h, twiddle);
+	for (int i = 0; i < h - 1; ++i) {
+		x[2 * i] = tmp[i];
+		x[2 * i + 1] = tmp[i + h] + tmp[i + h + 1];
+	}
+	x[N - 2] = tmp[h - 1];
+	x[N - 1] = tmp[N - 1];
+}
+
+// Orthonormal DCT of t->len samples in software, out must not alias in.
+void sw_dct(const sw_dct_t* t, const float* in, float* out, int direct) {
+	int len = t->len;
+	if (direct) {
+		for (int j = 0; j < len; ++j) {
+			float sum = 0;
+			for (int k = 0; k < len; ++k) sum = sum + in[k] * cos(PI * (k + 0.5) * j / len);
+			out[j] = sum;
+		}
+	} else if (t->fast) {
+		float tmp[len];
+		for (int k = 0; k < len; ++k) out[k] = in[k];
+		lee_dct(out, tmp, len, t->twiddle);
+	} else {
+		for (int j = 0; j < len; ++j) {
+			float sum = 0;
+			for (int k = 0; k < len; ++k) sum = sum + in[k] * t->cosines[j * len + k];
+			out[j] = sum;
+		}
+	}
+	for (int j = 0; j < len; ++j) {
+		if (j == 0) out[j] = out[j] / sqrt(len);
+		else out[j] = out[j] * sqrt(2.0 / len);
+	}
+}
+
+void perf_print(const char* name, volatile uint32_t* perf) {
+	printf("%s: busy %u idle %u input-full %u output-empty %u ops %u bytes %u\n", name,
+		(unsigned)perf[PERF_BUSY], (unsigned)perf[PERF_IDLE], (unsigned)perf[PERF_IN_FULL],
+		(unsigned)perf[PERF_OUT_EMPTY], (unsigned)perf[PERF_OPS], (unsigned)perf[PERF_BYTES]);
+}
+
+char* pe_base(int pe) {
+	return (char*)(CONFIG_ROM[CONFIG_PE_BASE] + pe * CONFIG_ROM[CONFIG_PE_STRIDE]);
+}
+
 float phase_correction(float phase) {
 	float new_phase = phase;
 	while (new_phase > 180.0) new_phase = new_phase - 360.0;
@@ -133,9 +640,15 @@ float phase_correction(float phase) {
 	return new_phase;
 }
 
-// Total number of cores
-// static const int PROCESSORS = 2;
-#define PROCESSORS 2
+// low word of the CLINT mtime counter
+uint32_t read_time() {
+	uint32_t t;
+	__asm__ __volatile__("rdtime %0" : "=r"(t));
+	return t;
+}
+
+// Total number of cores, from the config ROM
+int processors;
 // the barrier synchronization objects
 uint32_t barrier_counter=0; 
 uint32_t barrier_lock; 
@@ -143,24 +656,116 @@ uint32_t barrier_sem;
 // the mutex object to control global summation
 uint32_t lock;  
 // print synchronication semaphore (print in core order)
-uint32_t print_sem[PROCESSORS]; 
+uint32_t print_sem[MAX_PROCESSORS]; 
 // global memory
 float **input_memory;
 float **output_memory;
 int n, m;
+// software DCT tables of the rows (m) and columns (n)
+sw_dct_t row_dct;
+sw_dct_t col_dct;
 // file pointer
 FILE *input_fptr;
 FILE *output_fptr;
 
+// Rotation of (1, 0) by 180 (k + 0.5) j / m degrees in the packed format.
+// The phase is formed in integer Q9.7 and reduced to [-180, 180], no soft
+// float on the way to the PE.
+void packed_cos_job(packed_job_t* job, int k, int j) {
+	const int64_t full = (int64_t)360 << PE_Q_ANGLE_FRAC;
+	int64_t z = ((int64_t)180 << PE_Q_ANGLE_FRAC) * (2 * k + 1) * j / (2 * m) % full;
+	if (z > full / 2) z = z - full;
+	job->a = 1 << PE_Q_DATA_FRAC;
+	job->b = 0;
+	job->z = (int16_t)z;
+}
+
+float packed_cos(const packed_job_t* job) {
+	return job->a * (1.0f / (1 << PE_Q_DATA_FRAC));
+}
+
+void pe_wait_result(char* PE_BASE) {
+	if (!_is_using_pe_poll) return;
+	while (!(*(volatile uint32_t*)(PE_BASE + PE_STATUS) & PE_STATUS_RESULT))
+		;
+}
+
+// cos(180 (k + 0.5) j / m) as one PE job. Transfers use a DMA chain of
+// their own, so harts with a PE each need no lock; a shared PE is held
+// from the operand write to the result read.
+float pe_cos(char* PE_BASE, int k, int j, int shared_pe) {
+	if (_is_using_pe_packed) {
+		packed_job_t job;
+		packed_cos_job(&job, k, j);
+		if (shared_pe) sem_wait(&lock);
+		if (_is_using_dma) {
+			dma_memcpy(PE_BASE + PE_PACKED_AB, &job, sizeof(job));
+			dma_memcpy(&job, PE_BASE + PE_PACKED_OUT_AB, sizeof(job));
+		} else {
+			*(volatile uint32_t*)(PE_BASE + PE_PACKED_AB) = (uint16_t)job.a | ((uint32_t)(uint16_t)job.b << 16);
+			*(volatile int16_t*)(PE_BASE + PE_PACKED_Z) = job.z;
+			pe_wait_result(PE_BASE);
+			job.a = (int16_t)*(volatile uint32_t*)(PE_BASE + PE_PACKED_OUT_AB);
+			job.z = *(volatile int16_t*)(PE_BASE + PE_PACKED_OUT_Z);
+		}
+		if (shared_pe) sem_post(&lock);
+		return packed_cos(&job);
+	}
+	union pack data;
+	float phase = 180.0 * (k + 0.5) * j / m;
+	data.f[0] = 1.0;
+	data.f[1] = 0.0;
+	data.f[2] = phase_correction(phase);
+	if (shared_pe) sem_wait(&lock);
+	if (_is_using_dma) {
+		dma_memcpy(PE_BASE, data.uc, 12);
+		dma_memcpy(data.uc, PE_BASE + PE_OUTPUT, 12);
+	} else {
+		memcpy(PE_BASE, data.uc, 12);
+		pe_wait_result(PE_BASE);
+		memcpy(data.uc, PE_BASE + PE_OUTPUT, 12);
+	}
+	if (shared_pe) sem_post(&lock);
+	return data.f[0];
+}
+
+// Work buffers of a hart that grow with the row length come from the
+// heap, only for the mode that uses them: a hart's stack is 32 KiB. The
+// allocator is not reentrant, so harts take the lock around it.
+void* hart_malloc(size_t size) {
+	sem_wait(&lock);
+	void* p = malloc(size);
+	sem_post(&lock);
+	if (!p) {
+		printf("out of memory for %u bytes\n", (unsigned)size);
+		exit(1);
+	}
+	return p;
+}
+
+void hart_free(void* p) {
+	sem_wait(&lock);
+	free(p);
+	sem_post(&lock);
+}
+
 int main(unsigned hart_id) {
 	/////////////////////////////
 	// thread and barrier init //
 	/////////////////////////////
+	processors = CONFIG_ROM[CONFIG_HARTS];
+	if (processors > MAX_PROCESSORS) processors = MAX_PROCESSORS;
+	if (hart_id >= processors) return 0;
+	dma_channels = DMA_ADDR[DMA_CHANNELS];
+	if (_is_using_dma_irq) {
+		register_interrupt_handler(CONFIG_ROM[CONFIG_DMA_IRQ] + hart_id, dma_irq_handler);
+		enable_external_interrupts();
+	}
 	if (hart_id == 0) {
-		// create a barrier object with a count of PROCESSORS
+		// create a barrier object with a count of processors
 		sem_init(&barrier_lock, 1);
 		sem_init(&barrier_sem, 0); //lock all cores initially
-		for(int i=0; i< PROCESSORS; ++i){
+		for(int i=0; i< processors; ++i){
 			sem_init(&print_sem[i], 0); //lock printing initially
 		}
 		// Create mutex lock
@@ -187,27 +792,140 @@ int main(unsigned hart_id) {
 			output_memory[i] = malloc(m * sizeof(float));
 			for (int j = 0; j < m; ++j) {
 				fscanf(input_fptr, "%f", &input_memory[i][j]);
-				output_memory[i][j] = 0;
+			}
+			if (_is_using_dma) {
+				dma_memset(output_memory[i], 0, m * sizeof(float));
+			} else {
+				for (int j = 0; j < m; ++j) output_memory[i][j] = 0;
 			}
 		}
 		fclose(input_fptr);
+		if (_is_using_sw_dct || _is_using_2d) {
+			sw_dct_init(&row_dct, m);
+			sw_dct_init(&col_dct, n);
+		}
 	}
 	/////////////////////////////////
 	//  Read file Synchronization  //
 	/////////////////////////////////
-	if (hart_id == 0) sem_post(&print_sem[1]);
-	else sem_wait(&print_sem[1]); 
+	if (hart_id == 0) {
+		for (int h = 1; h < processors; ++h) sem_post(&print_sem[h]);
+	} else sem_wait(&print_sem[hart_id]); 
 
 	/////////////////////////////////
 	//       Computation           //
 	/////////////////////////////////
+	// harts share the PEs round robin if there are fewer PEs than harts
+	uint32_t start_time = read_time();
+	int pes = CONFIG_ROM[CONFIG_PES];
+	int shared_pe = pes < processors;
+	int shared_dma = _is_using_dma && dma_channel_shared(processors);
+	char* own_pe = pe_base(hart_id % pes);
+	volatile uint32_t* own_perf = (volatile uint32_t*)(own_pe + PE_PERF);
+	char* pool = (char*)CONFIG_ROM[CONFIG_POOL_BASE];
+	volatile uint32_t* pool_port = (volatile uint32_t*)(pool + POOL_PORT + hart_id * POOL_PORT_STRIDE);
+	volatile uint32_t* pool_perf = (volatile uint32_t*)(pool + POOL_PERF);
+	if (_is_reporting_perf) {
+		own_perf[PERF_CTRL] = PERF_RESET;
+		if (hart_id == 0) DMA_PERF_ADDR[PERF_CTRL] = PERF_RESET;
+		if (hart_id == 0) pool_perf[PERF_CTRL] = PERF_RESET;
+	}
 	unsigned char  buffer[12] = {0};
   	union pack data;
 	float phase;
-	for (int i = 0; i < n; ++i) {
+	volatile uint32_t chain_done;
+	// the pool serves any number of harts, the batch, DCT and coefficient
+	// interfaces need a PE per hart
+	int by_sw = _is_using_sw_dct != SW_DCT_OFF;
+	int sw_direct = _is_using_sw_dct == SW_DCT_DIRECT;
+	int pooled = _is_using_pe_pool;
+	int queued = pooled || ((_is_using_dma_chain || _is_using_pe_batch || _is_using_dma_stream) && !shared_pe);
+	int by_row = _is_using_pe_dct && m <= PE_DCT_MAX_LEN && !shared_pe && !pooled && !by_sw;
+	int by_coef = _is_using_pe_coef && m <= PE_COEF_MAX_M && !by_row && !queued && !shared_pe && !by_sw;
+	int by_rows = _is_using_row_partition && !by_row && !by_sw;
+	int packed_stream = _is_using_pe_packed && _is_using_dma_stream && !pooled && !_is_using_pe_batch;
+	int chained = queued && !pooled && !_is_using_pe_batch && !_is_using_dma_stream;
+	union pack* jobs = queued ? hart_malloc(m * sizeof(union pack)) : 0;
+	dma_desc_t* chain_desc = chained ? hart_malloc((2 * m + 1) * sizeof(dma_desc_t)) : 0;
+	pool_job_t* pool_records = pooled ? hart_malloc(POOL_PORT_DEPTH * sizeof(pool_job_t)) : 0;
+	dma_desc_t* pool_desc = pooled ? hart_malloc((POOL_PORT_DEPTH + 1) * sizeof(dma_desc_t)) : 0;
+	float* cosines = by_rows ? hart_malloc(m * sizeof(float)) : 0;
+	packed_job_t* packed_jobs = by_rows && queued && packed_stream ? hart_malloc(m * sizeof(packed_job_t)) : 0;
+	if (by_coef) pe_coef_init(own_pe, m);
+	// every row belongs to one hart, no accumulation across harts
+	for (int i = hart_id; i < n && by_row; i = i + processors) {
+		run_row_by_pe_dct(own_pe, input_memory[i], output_memory[i], m);
+	}
+	for (int i = hart_id; i < n && by_sw; i = i + processors) {
+		sw_dct(&row_dct, input_memory[i], output_memory[i], sw_direct);
+	}
+	// Lock-free row partition on the cosine jobs. The sum over k is formed
+	// the way the k-partitioned kernel forms it, as one partial sum per
+	// hart over k = h, h + processors, ..., scaled and added in hart
+	// order, so the result is bit-identical.
+	for (int i = hart_id; i < n && by_rows; i = i + processors) {
+		for (int j = 0; j < m; ++j) {
+			if (queued && packed_stream) {
+				for (int k = 0; k < m; ++k) packed_cos_job(&packed_jobs[k], k, j);
+				run_jobs_by_dma_stream(own_pe + PE_PACKED_AB, own_pe + PE_PACKED_OUT_AB, packed_jobs, m,
+					sizeof(packed_job_t));
+				for (int k = 0; k < m; ++k) cosines[k] = packed_cos(&packed_jobs[k]);
+			} else if (queued) {
+				for (int k = 0; k < m; ++k) {
+					jobs[k].f[0] = 1.0;
+					jobs[k].f[1] = 0.0;
+					phase = 180.0 * (k + 0.5) * j / m;
+					jobs[k].f[2] = phase_correction(phase);
+				}
+				if (pooled) run_jobs_by_pe_pool(pool_port, jobs, m, pool_records, pool_desc);
+				else if (_is_using_pe_batch) run_jobs_by_pe_batch(own_pe, jobs, m);
+				else if (_is_using_dma_stream) run_jobs_by_dma_stream(own_pe, own_pe + PE_OUTPUT, jobs, m, 12);
+				else run_jobs_by_dma_chain(own_pe, own_pe + PE_OUTPUT, jobs, m, chain_desc, &chain_done);
+				for (int k = 0; k < m; ++k) cosines[k] = jobs[k].f[0];
+			} else {
+				for (int k = 0; k < m; ++k) {
+					cosines[k] = by_coef ? pe_coef(own_pe, k, j) : pe_cos(own_pe, k, j, shared_pe);
+				}
+			}
+			float sum = 0;
+			for (int h = 0; h < processors; ++h) {
+				float local_sum = 0;
+				for (int k = h; k < m; k = k + processors) {
+					local_sum = local_sum + input_memory[i][k] * cosines[k];
+				}
+				if (j == 0) local_sum = local_sum / sqrt(m);
+				else local_sum = local_sum * sqrt(2.0 / m);
+				sum = sum + local_sum;
+			}
+			output_memory[i][j] = sum;
+		}
+	}
+	for (int i = 0; i < n && !by_row && !by_rows && !by_sw; ++i) {
 		for (int j = 0; j < m; ++j) {
 			float local_sum = 0;
-			for (int k = hart_id; k < m; k = k + PROCESSORS) {	
+			if (queued) {
+				int count = 0;
+				for (int k = hart_id; k < m; k = k + processors) {
+					jobs[count].f[0] = 1.0;
+					jobs[count].f[1] = 0.0;
+					phase = 180.0 * (k + 0.5) * j / m;
+					jobs[count].f[2] = phase_correction(phase);
+					count++;
+				}
+				if (pooled) run_jobs_by_pe_pool(pool_port, jobs, count, pool_records, pool_desc);
+				else if (_is_using_pe_batch) run_jobs_by_pe_batch(own_pe, jobs, count);
+				else if (_is_using_dma_stream) run_jobs_by_dma_stream(own_pe, own_pe + PE_OUTPUT, jobs, count, 12);
+				else run_jobs_by_dma_chain(own_pe, own_pe + PE_OUTPUT, jobs, count, chain_desc, &chain_done);
+				count = 0;
+				for (int k = hart_id; k < m; k = k + processors) {
+					local_sum = local_sum + input_memory[i][k] * jobs[count].f[0];
+					count++;
+				}
+			}
+			for (int k = hart_id; k < m && by_coef; k = k + processors) {
+				local_sum = local_sum + input_memory[i][k] * pe_coef(own_pe, k, j);
+			}
+			for (int k = hart_id; k < m && !queued && !by_coef; k = k + processors) {	
 				/////////////////////////
 				// calculate local sum //
 				/////////////////////////
@@ -217,15 +935,16 @@ int main(unsigned hart_id) {
 				phase = 180.0 * (k + 0.5) * j / m;
 				data.f[2] = phase_correction(phase);
 				for (int l = 0; l < 12; l++) buffer[l] = data.uc[l];
-				// write data to PE
-				sem_wait(&lock);
-				if (hart_id == 0) write_data_to_ACC(PE1_START_ADDR, buffer, 12);
-				else write_data_to_ACC(PE2_START_ADDR, buffer, 12);
-				sem_post(&lock);
-				sem_wait(&lock);
-				if (hart_id == 0) read_data_from_ACC(PE1_OUTPUT_ADDR, buffer, 12);
-				else read_data_from_ACC(PE2_OUTPUT_ADDR, buffer, 12);
-				sem_post(&lock);
+				// write data to PE, a shared PE is held until the result is
+				// read, a shared DMA channel for each transfer
+				if (shared_pe || shared_dma) sem_wait(&lock);
+				write_data_to_ACC(own_pe, buffer, 12);
+				if (!shared_pe && shared_dma) {
+					sem_post(&lock);
+					sem_wait(&lock);
+				}
+				read_data_from_ACC(own_pe + PE_OUTPUT, buffer, 12);
+				if (shared_pe || shared_dma) sem_post(&lock);
 				// accumulate local sum
 				for (int l = 0; l < 12; l++) data.uc[l] = buffer[l];
 				local_sum = local_sum + input_memory[i][k] * data.f[0];
@@ -241,18 +960,61 @@ int main(unsigned hart_id) {
 		}
 	}
 
+	// 2D: columns of the row transform, split between the harts once all
+	// rows are done
+	if (_is_using_2d) {
+		barrier(&barrier_sem, &barrier_lock, &barrier_counter, processors);
+		float* column = hart_malloc(2 * n * sizeof(float));
+		float* column_out = column + n;
+		for (int j = hart_id; j < m; j = j + processors) {
+			for (int i = 0; i < n; ++i) column[i] = output_memory[i][j];
+			if (by_row && n <= PE_DCT_MAX_LEN) run_row_by_pe_dct(own_pe, column, column_out, n);
+			else sw_dct(&col_dct, column, column_out, sw_direct);
+			for (int i = 0; i < n; ++i) output_memory[i][j] = column_out[i];
+		}
+		hart_free(column);
+	}
+
 	////////////////////////////
 	// barrier to synchronize //
 	////////////////////////////
 	//Wait for all threads to finish
-	barrier(&barrier_sem, &barrier_lock, &barrier_counter, PROCESSORS);
+	barrier(&barrier_sem, &barrier_lock, &barrier_counter, processors);
+	uint32_t compute_time = read_time() - start_time;
+	if (_is_reporting_perf) {
+		own_perf[PERF_CTRL] = PERF_FREEZE;
+		if (hart_id == 0) DMA_PERF_ADDR[PERF_CTRL] = PERF_FREEZE;
+		if (hart_id == 0) pool_perf[PERF_CTRL] = PERF_FREEZE;
+	}
 
-	if (hart_id == 0) {  // Core 0 print first and then others
-		printf("core%d is finished\n", hart_id);
-		sem_post(&print_sem[1]);  // Allow Core 1 to print
+	// print in core order, the last core writes the output file
+	if (hart_id > 0) sem_wait(&print_sem[hart_id]);
+	// in core order as well, printf allocates without the lock
+	hart_free(jobs);
+	hart_free(chain_desc);
+	hart_free(pool_records);
+	hart_free(pool_desc);
+	hart_free(cosines);
+	hart_free(packed_jobs);
+	if (hart_id == 0) printf("core%d is finished\n", hart_id);
+	else printf("core%d, finished\n", hart_id);
+	if (_is_reporting_time && hart_id == 0) {
+		const char* kernel = by_sw ? (sw_direct ? "software direct" : "software fast")
+			: by_row ? "PE row DCT" : by_rows ? "row partitioned" : "k partitioned";
+		printf("computation: %u mtime ticks, %s kernel%s, %d harts\n", (unsigned)compute_time, kernel,
+			_is_using_2d ? " 2D" : "", processors);
+	}
+	if (_is_reporting_perf) {
+		char name[8];
+		sprintf(name, "pe%d", hart_id + 1);
+		if (hart_id < pes) perf_print(name, own_perf);
+		if (hart_id == 0) perf_print("dma", DMA_PERF_ADDR);
+		if (hart_id == 0 && pooled) perf_print("pool", pool_perf);
+	}
+	if ((hart_id == 0 || !shared_dma) && (dma_channel(hart_id)[DMA_STATUS] & DMA_STATUS_ERROR)) printf("DMA reported an error\n");
+	if (hart_id < processors - 1) {
+		sem_post(&print_sem[hart_id + 1]);  // Allow the next core to print
 	} else {
-			sem_wait(&print_sem[1]); 
-			printf("core%d, finished\n", hart_id);
 			for (int i = 0; i < n; ++i) {
 				for (int j = 0; j < m; ++j) {
 					fprintf(output_fptr, "%g ", output_memory[i][j]);
@@ -1,119 +1,223 @@
 #ifndef PE_H
 #define PE_H
 
+#include <algorithm>
 #include <iomanip>
 #include <cmath>
-#include "angle_table.h"
+#include <deque>
+#include <vector>
 
 #include <systemc>
 using namespace sc_core;
 
 #include <tlm>
 #include <tlm_utils/simple_target_socket.h>
+#include <tlm_utils/peq_with_get.h>
+
+#include "core/common/irq_if.h"
 
 #include "defines.h"
+#include "cordic.h"
+#include "cordic_dct.h"
+#include "dma_flow.h"
+#include "perf_counters.h"
 
-class PE : public sc_module {
+// CORDIC accelerator, W bit data/angle words with DATA_I/ANGLE_I integer
+// bits and ITER rotation stages.
+template <int W, int DATA_I, int ANGLE_I, unsigned int ITER>
+class CordicPE : public sc_module, public dma_flow_if {
     public:
-        tlm_utils::simple_target_socket<PE> tsock;
+        typedef pe_fixed<W, DATA_I> data_t;
+        typedef pe_fixed<W, ANGLE_I> angle_t;
+        typedef CORDIC_datapath<data_t, angle_t, ITER> datapath_t;
+        typedef typename datapath_t::output_t CORDIC_output_t;
+        typedef pe_fixed<W, 2> coef_t;
+        typedef CORDIC_dct<data_t, angle_t, coef_t, ITER> dct_t;
+
+        tlm_utils::simple_target_socket<CordicPE> tsock;
 
         sc_fifo<data_t> i_a;
         sc_fifo<data_t> i_b;
         sc_fifo<angle_t> i_z;
+        sc_fifo<bool> i_mode;  // true: vectoring
         sc_fifo<data_t> o_a;
         sc_fifo<data_t> o_b;
         sc_fifo<angle_t> o_z;
 
-        SC_HAS_PROCESS( PE );
+        // optional batch/DCT completion interrupt
+        interrupt_gateway *plic = 0;
+        uint32_t irq_number = 0;
+
+        // input correction + ITER CORDIC_one stages + gain scaling
+        static const unsigned int PIPE_STAGES = ITER + 2;
 
-        PE(sc_module_name n) : sc_module(n), tsock("t_skt"), base_offset(0) {
-            tsock.register_b_transport(this, &PE::blocking_transport);
-            SC_THREAD(comp);
+        SC_HAS_PROCESS( CordicPE );
+
+        CordicPE(sc_module_name n, bool pipelined = false, sc_time clock_period = sc_time(10, SC_NS),
+                 bool loosely_timed = false)
+            : sc_module(n), tsock("t_skt"), pipelined(pipelined), clock_period(clock_period),
+              loosely_timed(loosely_timed), base_offset(0), perf(clock_period), at_requests("at_requests") {
+            tsock.register_b_transport(this, &CordicPE::blocking_transport);
+            tsock.register_nb_transport_fw(this, &CordicPE::nb_transport_fw);
+            if (pipelined) {
+                SC_THREAD(pipeline);
+            } else {
+                SC_THREAD(comp);
+            }
+            SC_THREAD(batch);
+            SC_THREAD(dct);
+            SC_THREAD(coef_fill);
+            SC_THREAD(at_target);
         }
 
-        ~PE() = default;
+        ~CordicPE() = default;
 
-    private:
-        unsigned int base_offset;
+        // cycles from accepting a triple until its result is in the output
+        // fifos, the untimed datapath takes no time of its own
+        sc_time latency() const {
+            return pipelined ? clock_period * PIPE_STAGES : SC_ZERO_TIME;
+        }
+
+        // minimum distance between two accepted triples
+        sc_time initiation_interval() const {
+            return pipelined ? clock_period : SC_ZERO_TIME;
+        }
+
+        // register time of one job through the bus: the A, B and Z operand
+        // writes and result reads, the cost both PE models can be compared by
+        sc_time job_access_time() const {
+            return access_delay(input_delay) + access_delay(output_delay) + access_delay(register_delay) * 4;
+        }
+
+        void show_timing() const {
+            std::cout << name() << ": " << (pipelined ? "pipelined" : "untimed") << " CORDIC<" << W << ", "
+                      << DATA_I << ", " << ANGLE_I << ", " << ITER << ">" << std::endl;
+            std::cout << "  jobs completed       = " << jobs << std::endl;
+            std::cout << "  latency              = " << latency() << std::endl;
+            std::cout << "  initiation interval  = " << initiation_interval() << std::endl;
+            std::cout << "  register access      = " << access_delay(register_delay) << ", first operand "
+                      << access_delay(input_delay) << ", first result " << access_delay(output_delay) << std::endl;
+            std::cout << "  job register time    = " << job_access_time() << std::endl;
+            if (pipelined && jobs > 0) {
+                std::cout << "  measured latency     = " << (latency_sum / (double) jobs) << " (avg)" << std::endl;
+            }
+            if (pipelined && jobs > 1) {
+                std::cout << "  measured interval    = " << ((last_retire - first_retire) / (double) (jobs - 1))
+                          << " (avg)" << std::endl;
+            }
+            if (dct_rows > 0) {
+                std::cout << "  DCT rows             = " << dct_rows << std::endl;
+                std::cout << "  DCT rotations        = " << dct_rotations << std::endl;
+            }
+        }
+
+        // DMA request lines, from the fifo levels. The loosely-timed
+        // shortcut computes on the Z write, so it always takes a triple.
+        unsigned in_free() override {
+            if (direct()) return 1;
+            int n = std::min(std::min(i_a.num_free(), i_b.num_free()), std::min(i_z.num_free(), i_mode.num_free()));
+            return (unsigned) n;
+        }
+
+        unsigned out_available() override {
+            if (direct()) return lt_out_z.size();
+            int n = std::min(o_a.num_available(), std::min(o_b.num_available(), o_z.num_available()));
+            return (unsigned) n;
+        }
+
+        const sc_event &in_space_event() override {
+            return i_mode.data_read_event();
+        }
 
-        CORDIC_output_t CORDIC_one(data_t x_0, data_t y_0, angle_t theta_0, bool mode, unsigned int SFL, angle_t theta_const) {
-            data_t tmp_x;
-            data_t tmp_y;
-            angle_t tmp_theta;
+        const sc_event &out_data_event() override {
+            return o_z.data_written_event();
+        }
+
+        // register access times of the untimed PE, the pipelined one takes
+        // a clock period for every access
+        void set_timing(sc_time input, sc_time output, sc_time reg) {
+            input_delay = input;
+            output_delay = output;
+            register_delay = reg;
+        }
+
+    private:
+        typedef struct pipe_reg {
+            bool valid;
+            bool mode;
             data_t x;
             data_t y;
             angle_t theta;
-            CORDIC_output_t o_data;
-
-            tmp_x = x_0 >> SFL;
-            tmp_y = y_0 >> SFL;
-            if (mode) { // vectoring mode
-                if (y > 0) { // rotate negative degree
-                    tmp_x = -tmp_x;
-                    tmp_theta = theta_const;
-                } else {     // rotate positive degree
-                    tmp_y = -tmp_y;
-                    tmp_theta = -theta_const;
-                }
-            } else { // rotation mode
-                if (theta_0 > 0) { // rotate positive degree
-                    tmp_y = -tmp_y;
-                    tmp_theta = -theta_const;
-                } else {           // rotate negative degree
-                    tmp_x = -tmp_x;
-                    tmp_theta = theta_const;
-                }
-            }
-            x = x_0 + tmp_y;
-            y = tmp_x + y_0; 
-            theta = theta_0 + tmp_theta;
-            o_data.x = x;
-            o_data.y = y;
-            o_data.theta = theta;
-            return o_data;
-        }
-
-        CORDIC_output_t CORDIC(data_t x_0, data_t y_0, angle_t theta_0, bool mode) {
-            data_t cor_x;
-            data_t cor_y;
-            angle_t cor_theta;
-            CORDIC_output_t CORDIC_out;
-            data_t factor = 0.6072776441;    
-        
-            // input correction
-            if (mode) {   // vectoring mode
-                if (y_0 > 0) {
-                    cor_x = y_0; // rotate -90 degree
-                    cor_y = -x_0;
-                    cor_theta = theta_0 + 90.0;
-                } else {
-                    cor_x = -y_0; // rotate 90 degree
-                    cor_y = x_0;  
-                    cor_theta = theta_0 - 90.0;
-                }
-            } else {     // rotation mode
-                if(theta_0 > 0) {
-                    cor_x = -y_0; // rotate 90 degree
-                    cor_y = x_0;  
-                    cor_theta = theta_0 - 90.0;
-                } else {
-                    cor_x = y_0;  // rotate -90 degree
-                    cor_y = -x_0;
-                    cor_theta = theta_0 + 90.0;
-                }
-            }
-            // computation
-            CORDIC_out = CORDIC_one(cor_x, cor_y, cor_theta, mode, 0, ANGLE0);
-            CORDIC_out = CORDIC_one(CORDIC_out.x, CORDIC_out.y, CORDIC_out.theta, mode, 1, ANGLE1);
-            CORDIC_out = CORDIC_one(CORDIC_out.x, CORDIC_out.y, CORDIC_out.theta, mode, 2, ANGLE2);
-            CORDIC_out = CORDIC_one(CORDIC_out.x, CORDIC_out.y, CORDIC_out.theta, mode, 3, ANGLE3);
-            CORDIC_out = CORDIC_one(CORDIC_out.x, CORDIC_out.y, CORDIC_out.theta, mode, 4, ANGLE4);
-            CORDIC_out = CORDIC_one(CORDIC_out.x, CORDIC_out.y, CORDIC_out.theta, mode, 5, ANGLE5);
-            CORDIC_out = CORDIC_one(CORDIC_out.x, CORDIC_out.y, CORDIC_out.theta, mode, 6, ANGLE6);
-            CORDIC_out.x = CORDIC_out.x * factor;
-            CORDIC_out.y = CORDIC_out.y * factor;
-            return CORDIC_out; 
-        }
+            sc_time issued;
+        } pipe_reg_t;
+
+        bool pipelined;
+        sc_time clock_period;
+        bool loosely_timed;
+        unsigned int base_offset;
+        // first operand write (INPUT_A, PACKED_AB), first result read
+        // (OUTPUT_A, PACKED_OUT_AB) and any other register
+        sc_time input_delay = sc_time(30, SC_NS);
+        sc_time output_delay = sc_time(90, SC_NS);
+        sc_time register_delay = sc_time(10, SC_NS);
+
+        // guest visible counters, busy while the pipeline holds a job or a
+        // batch, DCT row or coefficient fill is running
+        PerfCounters perf;
+        bool pipe_busy = false;
+
+        // poll interface, see PE_STATUS_ADDR
+        bool nonblock = false;
+        bool underrun = false;
+        bool overrun = false;
+
+        // approximately-timed requests, accepted at once and served in
+        // order by at_target()
+        tlm_utils::peq_with_get<tlm::tlm_generic_payload> at_requests;
+
+        // loosely-timed shortcut to the untimed datapath, see direct()
+        data_t lt_a;
+        data_t lt_b;
+        std::deque<data_t> lt_out_a;
+        std::deque<data_t> lt_out_b;
+        std::deque<angle_t> lt_out_z;
+        unsigned int mode = PE_MODE_ROTATION;
+
+        pipe_reg_t pipe_regs[PIPE_STAGES] = {};
+        uint64_t jobs = 0;
+        sc_time latency_sum;
+        sc_time first_retire;
+        sc_time last_retire;
+
+        // batch operand/result SRAM, raw float words {a, b, z} per job
+        unsigned int batch_in[PE_BATCH_DEPTH * 3] = {};
+        unsigned int batch_out[PE_BATCH_DEPTH * 3] = {};
+        unsigned int batch_count = 0;
+        unsigned int batch_done = 0;
+        bool batch_busy = false;
+        bool batch_finished = false;
+        bool batch_irq = false;
+        sc_event batch_start_event;
+
+        // DCT row SRAM, raw float words
+        unsigned int dct_in[PE_DCT_MAX_LEN] = {};
+        unsigned int dct_out[PE_DCT_MAX_LEN] = {};
+        unsigned int dct_len = 8;
+        bool dct_busy = false;
+        bool dct_finished = false;
+        bool dct_irq = false;
+        uint64_t dct_rows = 0;
+        uint64_t dct_rotations = 0;
+        sc_event dct_start_event;
+
+        // DCT coefficient table. (2k + 1) j only matters modulo 4m, so the
+        // SRAM holds the 4m distinct cosines as raw float words.
+        std::vector<unsigned int> coef_table;
+        unsigned int coef_m = 0;
+        unsigned int coef_index = 0;
+        bool coef_busy = false;
+        bool coef_finished = false;
+        sc_event coef_start_event;
 
         void comp() {
             while (true) {
@@ -123,15 +227,17 @@ class PE : public sc_module {
                 data_t output_a;
                 data_t output_b;
                 angle_t output_z;
+                bool input_mode;
                 CORDIC_output_t CORDIC_out;
                 {
                     // input
                     input_a = i_a.read();
                     input_b = i_b.read();
                     input_z = i_z.read();
+                    input_mode = i_mode.read();
                 }
                 // computation
-                CORDIC_out = CORDIC(input_a, input_b, input_z, false);
+                CORDIC_out = datapath_t::run(input_a, input_b, input_z, input_mode);
                 output_a = CORDIC_out.x;
                 output_b = CORDIC_out.y;
                 output_z = CORDIC_out.theta;
@@ -141,68 +247,306 @@ class PE : public sc_module {
                     o_b.write(output_b);
                     o_z.write(output_z);
                 }
+                jobs++;
+                perf.op();
+            }
+        }
+
+        // Streams the operand SRAM through the datapath (untimed or
+        // pipelined, whichever is configured) and collects the results.
+        // Operands are issued as long as the input fifos have room, so the
+        // fifo depth does not limit the batch size.
+        void batch() {
+            while (true) {
+                wait(batch_start_event);
+                perf.busy_begin();
+
+                unsigned int issued = 0;
+                while (batch_done < batch_count) {
+                    while (issued < batch_count && i_a.num_free() > 0 && i_b.num_free() > 0 && i_z.num_free() > 0 &&
+                           i_mode.num_free() > 0) {
+                        word a, b, z;
+                        a.ui = batch_in[issued * 3];
+                        b.ui = batch_in[issued * 3 + 1];
+                        z.ui = batch_in[issued * 3 + 2];
+                        i_a.nb_write((data_t) a.f);
+                        i_b.nb_write((data_t) b.f);
+                        i_z.nb_write((angle_t) z.f);
+                        i_mode.nb_write(mode == PE_MODE_VECTORING);
+                        issued++;
+                    }
+                    if (o_z.num_available() == 0) {
+                        wait(o_z.data_written_event());
+                    }
+                    while (o_a.num_available() > 0 && o_b.num_available() > 0 && o_z.num_available() > 0) {
+                        data_t out_a, out_b;
+                        angle_t out_z;
+                        o_a.nb_read(out_a);
+                        o_b.nb_read(out_b);
+                        o_z.nb_read(out_z);
+                        word a, b, z;
+                        a.f = (float) out_a;
+                        b.f = (float) out_b;
+                        z.f = (float) out_z;
+                        batch_out[batch_done * 3] = a.ui;
+                        batch_out[batch_done * 3 + 1] = b.ui;
+                        batch_out[batch_done * 3 + 2] = z.ui;
+                        batch_done++;
+                    }
+                }
+
+                perf.busy_end();
+                batch_busy = false;
+                batch_finished = true;
+                if (batch_irq && plic) {
+                    plic->gateway_trigger_interrupt(irq_number);
+                }
+            }
+        }
+
+        // Transforms the row in the DCT SRAM. The pipelined PE streams the
+        // row through the butterflies at one sample per clock and issues one
+        // rotation per clock, the untimed one finishes immediately.
+        void dct() {
+            while (true) {
+                wait(dct_start_event);
+                perf.busy_begin();
+
+                std::vector<data_t> in(dct_len), out(dct_len);
+                for (unsigned int k = 0; k < dct_len; ++k) {
+                    word x;
+                    x.ui = dct_in[k];
+                    in[k] = (data_t) x.f;
+                }
+                unsigned int rotations = dct_t::transform(in.data(), out.data(), dct_len,
+                                                          std::ldexp(1.0, DATA_I - 1));
+                for (unsigned int j = 0; j < dct_len; ++j) {
+                    word X;
+                    X.f = (float) out[j];
+                    dct_out[j] = X.ui;
+                }
+                if (pipelined) {
+                    wait(latency() + clock_period * (rotations + dct_len));
+                }
+                dct_rows++;
+                dct_rotations += rotations;
+                perf.op();
+                perf.busy_end();
+
+                dct_busy = false;
+                dct_finished = true;
+                if (dct_irq && plic) {
+                    plic->gateway_trigger_interrupt(irq_number);
+                }
+            }
+        }
+
+        // Fills the coefficient table with one rotation of (1, 0) per entry,
+        // entry p holds cos(90 p / m), range reduced to [-180, 180] degrees.
+        void coef_fill() {
+            while (true) {
+                wait(coef_start_event);
+                perf.busy_begin();
+
+                unsigned int n = 4 * coef_m;
+                coef_table.assign(n, 0);
+                for (unsigned int p = 0; p < n; ++p) {
+                    int q = p <= 2 * coef_m ? (int) p : (int) p - (int) n;
+                    CORDIC_output_t out = datapath_t::run(data_t(1.0), data_t(0.0), (angle_t) (90.0 * q / coef_m), false);
+                    word c;
+                    c.f = (float) out.x;
+                    coef_table[p] = c.ui;
+                }
+                if (pipelined) {
+                    wait(latency() + clock_period * n);
+                }
+
+                perf.busy_end();
+                coef_busy = false;
+                coef_finished = true;
+            }
+        }
+
+        // One pipeline register per stage: pipe_regs[0] holds the corrected
+        // input, pipe_regs[1..ITER] the CORDIC_one results and the last one
+        // the scaled output. Every clock the last stage retires into the output
+        // fifos, all stages advance and a new triple is accepted, so the PE
+        // sustains one result per cycle. A full output fifo stalls the whole
+        // pipeline without clocking it until a result is read.
+        void pipeline() {
+            while (true) {
+                bool empty = true;
+                for (unsigned int s = 0; s < PIPE_STAGES; ++s) {
+                    empty = empty && !pipe_regs[s].valid;
+                }
+                if (empty && i_mode.num_available() == 0) {
+                    wait(i_mode.data_written_event());
+                }
+                // align to the next rising edge
+                wait(clock_period - (sc_time_stamp() % clock_period));
+
+                // retire
+                pipe_reg_t &last = pipe_regs[PIPE_STAGES - 1];
+                if (last.valid) {
+                    if (o_a.num_free() == 0 || o_b.num_free() == 0 || o_z.num_free() == 0) {
+                        // stalled until the consumer reads a result, then
+                        // retry on the next edge
+                        wait(o_a.data_read_event() | o_b.data_read_event() | o_z.data_read_event());
+                        continue;
+                    }
+                    o_a.nb_write(last.x);
+                    o_b.nb_write(last.y);
+                    o_z.nb_write(last.theta);
+                    last.valid = false;
+
+                    sc_time now = sc_time_stamp();
+                    if (jobs == 0) first_retire = now;
+                    last_retire = now;
+                    latency_sum += now - last.issued;
+                    jobs++;
+                    perf.op();
+                }
+
+                // advance
+                for (unsigned int s = PIPE_STAGES - 1; s > 0; --s) {
+                    pipe_reg_t &prev = pipe_regs[s - 1];
+                    pipe_reg_t &cur = pipe_regs[s];
+                    cur.valid = prev.valid;
+                    cur.mode = prev.mode;
+                    cur.issued = prev.issued;
+                    if (prev.valid) {
+                        CORDIC_output_t in;
+                        in.x = prev.x;
+                        in.y = prev.y;
+                        in.theta = prev.theta;
+                        CORDIC_output_t out = (s == PIPE_STAGES - 1) ? datapath_t::scale(in) : datapath_t::stage(s - 1, in, prev.mode);
+                        cur.x = out.x;
+                        cur.y = out.y;
+                        cur.theta = out.theta;
+                    }
+                }
+
+                // accept a new triple
+                pipe_reg_t &first = pipe_regs[0];
+                first.valid = false;
+                if (i_a.num_available() > 0 && i_b.num_available() > 0 && i_z.num_available() > 0 &&
+                    i_mode.num_available() > 0) {
+                    data_t input_a;
+                    data_t input_b;
+                    angle_t input_z;
+                    bool input_mode;
+                    i_a.nb_read(input_a);
+                    i_b.nb_read(input_b);
+                    i_z.nb_read(input_z);
+                    i_mode.nb_read(input_mode);
+                    CORDIC_output_t out = datapath_t::correction(input_a, input_b, input_z, input_mode);
+                    first.valid = true;
+                    first.mode = input_mode;
+                    first.x = out.x;
+                    first.y = out.y;
+                    first.theta = out.theta;
+                    first.issued = sc_time_stamp();
+                }
+
+                bool busy = false;
+                for (unsigned int s = 0; s < PIPE_STAGES; ++s) {
+                    busy = busy || pipe_regs[s].valid;
+                }
+                if (busy != pipe_busy) {
+                    pipe_busy = busy;
+                    if (busy) {
+                        perf.busy_begin();
+                    } else {
+                        perf.busy_end();
+                    }
+                }
             }
         }
 
+        // Register access cost. The untimed model keeps its historical
+        // per-register delays; the pipelined one charges one PE clock.
+        sc_time access_delay(sc_time legacy) const {
+            return pipelined ? clock_period : legacy;
+        }
+
+    // Bursts are split into consecutive 32-bit register accesses, so a
+    // 12-byte DMA transfer starting at PE_INPUT_A_ADDR writes A, B and Z in
+    // one transaction. A burst may end in a 16-bit access to one of the
+    // packed Z registers, e.g. 6 bytes at PE_PACKED_AB_ADDR.
+    //
+    // The loosely-timed target does not wait for the initiator's local time
+    // offset but adds its access cost to it, and only synchronizes when a
+    // fifo access would block, i.e. a result is not ready yet or the input
+    // fifos are full, or when the offset exceeds the global quantum.
     void blocking_transport(tlm::tlm_generic_payload &payload, sc_core::sc_time &delay){
-        wait(delay);
+        if (!loosely_timed) {
+            sync(delay);
+        }
+        register_access(payload, delay);
+        if (loosely_timed && delay >= tlm::tlm_global_quantum::instance().get()) {
+            sync(delay);
+        }
+    }
+
+    // AT base protocol: BEGIN_REQ is accepted right away with END_REQ, so
+    // the initiator and the bus are free again while the access waits for
+    // a result or an input slot in at_target(), which sends BEGIN_RESP.
+    tlm::tlm_sync_enum nb_transport_fw(tlm::tlm_generic_payload &payload, tlm::tlm_phase &phase,
+                                       sc_core::sc_time &delay) {
+        if (phase == tlm::BEGIN_REQ) {
+            at_requests.notify(payload, delay);
+            phase = tlm::END_REQ;
+            return tlm::TLM_UPDATED;
+        }
+        if (phase == tlm::END_RESP) {
+            return tlm::TLM_COMPLETED;
+        }
+        return tlm::TLM_ACCEPTED;
+    }
+
+    // Requests are served one at a time, in arrival order, like the single
+    // register port of the blocking path.
+    void at_target() {
+        while (true) {
+            wait(at_requests.get_event());
+            tlm::tlm_generic_payload *payload;
+            while ((payload = at_requests.get_next_transaction()) != 0) {
+                sc_time delay = SC_ZERO_TIME;
+                register_access(*payload, delay);
+                sync(delay);
+                tlm::tlm_phase phase = tlm::BEGIN_RESP;
+                tsock->nb_transport_bw(*payload, phase, delay);
+            }
+        }
+    }
+
+    // register access shared by the blocking and the AT path, blocking
+    // fifo accesses wait in the calling thread
+    void register_access(tlm::tlm_generic_payload &payload, sc_core::sc_time &delay) {
         // unsigned char *mask_ptr = payload.get_byte_enable_ptr();
-        // auto len = payload.get_data_length();
         tlm::tlm_command cmd = payload.get_command();
         sc_dt::uint64 addr = payload.get_address();
         unsigned char *data_ptr = payload.get_data_ptr();
+        unsigned int len = payload.get_data_length();
 
         addr -= base_offset;
 
-        word data;
+        if (len == 0 || (len % 4 != 0 && !(len % 4 == 2 && half_word(addr + len - 2)))) {
+            payload.set_response_status(tlm::TLM_BURST_ERROR_RESPONSE);
+            return;
+        }
 
         switch (cmd) {
         case tlm::TLM_READ_COMMAND:
-            // cout << "READ" << endl;
-            switch (addr) {
-            case PE_OUTPUT_A_ADDR:
-                data.f = (float) o_a.read();
-                delay = sc_time(90, SC_NS);
-                break;
-            case PE_OUTPUT_B_ADDR:
-                data.f = (float) o_b.read();
-                delay = sc_time(10, SC_NS);
-                break;
-            case PE_OUTPUT_Z_ADDR:
-                data.f = (float) o_z.read();
-                delay = sc_time(10, SC_NS);
-                break;
-            default:
-                std::cerr << "READ Error! PE::blocking_transport: address 0x"
-                        << std::setfill('0') << std::setw(8) << std::hex << addr
-                        << std::dec << " is not valid" << std::endl;
-            }
-            for (int i = 0; i < 4; ++i) {
-                data_ptr[i] = data.uc[i];
+            for (unsigned int i = 0; i < len; i += 4) {
+                sc_time access = read_word(addr + i, data_ptr + i, std::min(len - i, 4u), delay);
+                delay += access;
             }
             break;
         case tlm::TLM_WRITE_COMMAND:
-            // cout << "WRITE" << endl;
-            for (int i = 0; i < 4; ++i) {
-                data.uc[i] = data_ptr[i];
-            }
-            switch (addr) {
-            case PE_INPUT_A_ADDR:
-                i_a.write((data_t) data.f);
-                delay = sc_time(30, SC_NS);
-                break;
-            case PE_INPUT_B_ADDR:
-                i_b.write((data_t) data.f);
-                delay = sc_time(10, SC_NS);
-                break;
-            case PE_INPUT_Z_ADDR:
-                i_z.write((angle_t) data.f);
-                delay = sc_time(10, SC_NS);
-                break;
-            default:
-                std::cerr << "WRITE Error! SobelFilter::blocking_transport: address 0x"
-                        << std::setfill('0') << std::setw(8) << std::hex << addr
-                        << std::dec << " is not valid" << std::endl;
+            for (unsigned int i = 0; i < len; i += 4) {
+                sc_time access = write_word(addr + i, data_ptr + i, std::min(len - i, 4u), delay);
+                delay += access;
             }
             break;
         case tlm::TLM_IGNORE_COMMAND:
@@ -214,6 +558,340 @@ class PE : public sc_module {
         }
         payload.set_response_status(tlm::TLM_OK_RESPONSE); // Always OK
     }
+
+    void sync(sc_time &delay) {
+        if (delay != SC_ZERO_TIME) {
+            wait(delay);
+            delay = SC_ZERO_TIME;
+        }
+    }
+
+    // A loosely-timed target in front of the untimed datapath computes the
+    // job in the initiator's thread as soon as its Z operand arrives, so
+    // neither the operand writes nor the result reads need a context switch.
+    bool direct() const {
+        return loosely_timed && !pipelined;
+    }
+
+    template <typename T>
+    T output_read(sc_fifo<T> &f, std::deque<T> &direct_q, sc_time &delay) {
+        if (!direct_q.empty()) {
+            T v = direct_q.front();
+            direct_q.pop_front();
+            return v;
+        }
+        return fifo_read(f, delay);
+    }
+
+    // fifo accesses from the bus side, synchronize only if they would block.
+    // Reads only target the output fifos and writes the input fifos, the
+    // blocked time counts as output-empty or input-full stall. In
+    // non-blocking mode they fail instead and flag it in STATUS.
+    template <typename T>
+    T fifo_read(sc_fifo<T> &f, sc_time &delay) {
+        T v;
+        if (!f.nb_read(v)) {
+            if (nonblock) {
+                underrun = true;
+                return T(0.0);
+            }
+            sync(delay);
+            sc_time start = sc_time_stamp();
+            v = f.read();
+            perf.stall_out(sc_time_stamp() - start);
+        }
+        return v;
+    }
+
+    template <typename T>
+    void fifo_write(sc_fifo<T> &f, const T &v, sc_time &delay) {
+        if (!f.nb_write(v)) {
+            if (nonblock) {
+                overrun = true;
+                return;
+            }
+            sync(delay);
+            sc_time start = sc_time_stamp();
+            f.write(v);
+            perf.stall_in(sc_time_stamp() - start);
+        }
+    }
+
+    static bool in_window(sc_dt::uint64 addr, sc_dt::uint64 base, unsigned int size) {
+        return addr >= base && addr < base + size;
+    }
+
+    static bool half_word(sc_dt::uint64 addr) {
+        return addr == PE_PACKED_Z_ADDR || addr == PE_PACKED_OUT_Z_ADDR;
+    }
+
+    // Packed Q format: a 16-bit two's complement field with the integer
+    // bits of the PE word, i.e. pe_fixed<16, I>. Exact for W <= 16, wider
+    // PEs truncate like their own quantization.
+    template <int I>
+    static uint32_t to_q16(double v) {
+        return (uint16_t) (int32_t) std::floor(std::ldexp(v, 16 - I));
+    }
+
+    template <int I>
+    static double from_q16(uint32_t bits) {
+        return std::ldexp((double) (int16_t) (bits & 0xffff), I - 16);
+    }
+
+    // operand inputs shared by the float and the packed registers
+    void input_a(const data_t &a, sc_time &delay) {
+        if (direct()) {
+            lt_a = a;
+        } else {
+            fifo_write(i_a, a, delay);
+        }
+    }
+
+    void input_b(const data_t &b, sc_time &delay) {
+        if (direct()) {
+            lt_b = b;
+        } else {
+            fifo_write(i_b, b, delay);
+        }
+    }
+
+    // the Z operand completes a job, it runs in the current mode
+    void input_z(const angle_t &z, sc_time &delay) {
+        if (direct()) {
+            CORDIC_output_t out = datapath_t::run(lt_a, lt_b, z, mode == PE_MODE_VECTORING);
+            lt_out_a.push_back(out.x);
+            lt_out_b.push_back(out.y);
+            lt_out_z.push_back(out.theta);
+            jobs++;
+            perf.op();
+        } else {
+            fifo_write(i_z, z, delay);
+            fifo_write(i_mode, mode == PE_MODE_VECTORING, delay);
+        }
+    }
+
+    // table lookup for the (k, j) pair in the index register, 0 while the
+    // table is being filled
+    unsigned int coef_value() const {
+        if (!coef_finished) {
+            return 0;
+        }
+        uint64_t k = coef_index & 0xffff;
+        uint64_t j = coef_index >> 16;
+        return coef_table[((2 * k + 1) * j) % coef_table.size()];
+    }
+
+    sc_time read_word(sc_dt::uint64 addr, unsigned char *data_ptr, unsigned int n, sc_time &delay) {
+        word data;
+        sc_time access = SC_ZERO_TIME;
+        // cout << "READ" << endl;
+        if (in_window(addr, PE_BATCH_IN_ADDR, PE_BATCH_DEPTH * 12)) {
+            data.ui = batch_in[(addr - PE_BATCH_IN_ADDR) / 4];
+            access = access_delay(register_delay);
+        } else if (in_window(addr, PE_BATCH_OUT_ADDR, PE_BATCH_DEPTH * 12)) {
+            data.ui = batch_out[(addr - PE_BATCH_OUT_ADDR) / 4];
+            access = access_delay(register_delay);
+        } else if (in_window(addr, PE_DCT_IN_ADDR, PE_DCT_MAX_LEN * 4)) {
+            data.ui = dct_in[(addr - PE_DCT_IN_ADDR) / 4];
+            access = access_delay(register_delay);
+        } else if (in_window(addr, PE_DCT_OUT_ADDR, PE_DCT_MAX_LEN * 4)) {
+            data.ui = dct_out[(addr - PE_DCT_OUT_ADDR) / 4];
+            access = access_delay(register_delay);
+        } else if (in_window(addr, PE_PERF_ADDR, PERF_BLOCK_SIZE)) {
+            data.ui = perf.read(addr - PE_PERF_ADDR);
+            access = access_delay(register_delay);
+        } else switch (addr) {
+        case PE_OUTPUT_A_ADDR:
+            data.f = (float) output_read(o_a, lt_out_a, delay);
+            access = access_delay(output_delay);
+            break;
+        case PE_OUTPUT_B_ADDR:
+            data.f = (float) output_read(o_b, lt_out_b, delay);
+            access = access_delay(register_delay);
+            break;
+        case PE_OUTPUT_Z_ADDR:
+            data.f = (float) output_read(o_z, lt_out_z, delay);
+            access = access_delay(register_delay);
+            break;
+        case PE_MODE_ADDR:
+            data.ui = mode;
+            access = access_delay(register_delay);
+            break;
+        case PE_FIFO_STATUS_ADDR:
+            data.ui = (out_available() << 16) | in_free();
+            access = access_delay(register_delay);
+            break;
+        case PE_STATUS_ADDR:
+            data.ui = (out_available() > 0 ? PE_STATUS_RESULT : 0) | (in_free() > 0 ? PE_STATUS_ROOM : 0)
+                    | (underrun ? PE_STATUS_UNDERRUN : 0) | (overrun ? PE_STATUS_OVERRUN : 0);
+            access = access_delay(register_delay);
+            break;
+        case PE_CTRL_ADDR:
+            data.ui = nonblock ? PE_CTRL_NONBLOCK : 0;
+            access = access_delay(register_delay);
+            break;
+        case PE_PACKED_OUT_AB_ADDR: {
+            uint32_t a = to_q16<DATA_I>((double) output_read(o_a, lt_out_a, delay));
+            uint32_t b = to_q16<DATA_I>((double) output_read(o_b, lt_out_b, delay));
+            data.ui = a | (b << 16);
+            access = access_delay(output_delay);
+            break;
+        }
+        case PE_PACKED_OUT_Z_ADDR:
+            data.ui = to_q16<ANGLE_I>((double) output_read(o_z, lt_out_z, delay));
+            access = access_delay(register_delay);
+            break;
+        case PE_BATCH_COUNT_ADDR:
+            data.ui = batch_count;
+            access = access_delay(register_delay);
+            break;
+        case PE_BATCH_STATUS_ADDR:
+            data.ui = (batch_done << 16) | (batch_finished ? PE_BATCH_DONE : 0) | (batch_busy ? PE_BATCH_BUSY : 0);
+            access = access_delay(register_delay);
+            break;
+        case PE_DCT_LEN_ADDR:
+            data.ui = dct_len;
+            access = access_delay(register_delay);
+            break;
+        case PE_DCT_STATUS_ADDR:
+            data.ui = (dct_finished ? PE_BATCH_DONE : 0) | (dct_busy ? PE_BATCH_BUSY : 0);
+            access = access_delay(register_delay);
+            break;
+        case PE_COEF_M_ADDR:
+            data.ui = coef_m;
+            access = access_delay(register_delay);
+            break;
+        case PE_COEF_STATUS_ADDR:
+            data.ui = (coef_finished ? PE_BATCH_DONE : 0) | (coef_busy ? PE_BATCH_BUSY : 0);
+            access = access_delay(register_delay);
+            break;
+        case PE_COEF_INDEX_ADDR:
+            data.ui = coef_index;
+            access = access_delay(register_delay);
+            break;
+        case PE_COEF_VALUE_ADDR:
+            data.ui = coef_value();
+            access = access_delay(register_delay);
+            break;
+        default:
+            std::cerr << "READ Error! CordicPE::read_word (" << name() << "): address 0x"
+                    << std::setfill('0') << std::setw(8) << std::hex << addr
+                    << std::dec << " is not valid" << std::endl;
+        }
+        for (unsigned int i = 0; i < n; ++i) {
+            data_ptr[i] = data.uc[i];
+        }
+        return access;
+    }
+
+    sc_time write_word(sc_dt::uint64 addr, const unsigned char *data_ptr, unsigned int n, sc_time &delay) {
+        word data;
+        sc_time access = SC_ZERO_TIME;
+        // cout << "WRITE" << endl;
+        data.ui = 0;
+        for (unsigned int i = 0; i < n; ++i) {
+            data.uc[i] = data_ptr[i];
+        }
+        if (in_window(addr, PE_BATCH_IN_ADDR, PE_BATCH_DEPTH * 12)) {
+            batch_in[(addr - PE_BATCH_IN_ADDR) / 4] = data.ui;
+            access = access_delay(register_delay);
+        } else if (in_window(addr, PE_DCT_IN_ADDR, PE_DCT_MAX_LEN * 4)) {
+            dct_in[(addr - PE_DCT_IN_ADDR) / 4] = data.ui;
+            access = access_delay(register_delay);
+        } else if (in_window(addr, PE_PERF_ADDR, PERF_BLOCK_SIZE)) {
+            perf.write(addr - PE_PERF_ADDR, data.ui);
+            access = access_delay(register_delay);
+        } else switch (addr) {
+        case PE_INPUT_A_ADDR:
+            input_a((data_t) data.f, delay);
+            access = access_delay(input_delay);
+            break;
+        case PE_INPUT_B_ADDR:
+            input_b((data_t) data.f, delay);
+            access = access_delay(register_delay);
+            break;
+        case PE_INPUT_Z_ADDR:
+            input_z((angle_t) data.f, delay);
+            access = access_delay(register_delay);
+            break;
+        case PE_PACKED_AB_ADDR:
+            input_a((data_t) from_q16<DATA_I>(data.ui), delay);
+            input_b((data_t) from_q16<DATA_I>(data.ui >> 16), delay);
+            access = access_delay(input_delay);
+            break;
+        case PE_PACKED_Z_ADDR:
+            input_z((angle_t) from_q16<ANGLE_I>(data.ui), delay);
+            access = access_delay(register_delay);
+            break;
+        case PE_MODE_ADDR:
+            mode = data.ui;
+            access = access_delay(register_delay);
+            break;
+        case PE_STATUS_ADDR:
+            underrun = underrun && !(data.ui & PE_STATUS_UNDERRUN);
+            overrun = overrun && !(data.ui & PE_STATUS_OVERRUN);
+            access = access_delay(register_delay);
+            break;
+        case PE_CTRL_ADDR:
+            nonblock = data.ui & PE_CTRL_NONBLOCK;
+            access = access_delay(register_delay);
+            break;
+        case PE_BATCH_COUNT_ADDR:
+            if (!batch_busy) {
+                batch_count = data.ui < (unsigned int) PE_BATCH_DEPTH ? data.ui : PE_BATCH_DEPTH;
+            }
+            access = access_delay(register_delay);
+            break;
+        case PE_BATCH_START_ADDR:
+            if (!batch_busy && (data.ui & PE_BATCH_START)) {
+                batch_irq = data.ui & PE_BATCH_IRQ_ENABLE;
+                batch_busy = true;
+                batch_finished = false;
+                batch_done = 0;
+                batch_start_event.notify(SC_ZERO_TIME);
+            }
+            access = access_delay(register_delay);
+            break;
+        case PE_DCT_LEN_ADDR:
+            if (!dct_busy && data.ui > 0) {
+                dct_len = data.ui < (unsigned int) PE_DCT_MAX_LEN ? data.ui : PE_DCT_MAX_LEN;
+            }
+            access = access_delay(register_delay);
+            break;
+        case PE_COEF_M_ADDR:
+            if (!coef_busy && data.ui > 0 && data.ui <= (unsigned int) PE_COEF_MAX_M) {
+                coef_m = data.ui;
+                coef_busy = true;
+                coef_finished = false;
+                coef_start_event.notify(SC_ZERO_TIME);
+            }
+            access = access_delay(register_delay);
+            break;
+        case PE_COEF_INDEX_ADDR:
+            coef_index = data.ui;
+            access = access_delay(register_delay);
+            break;
+        case PE_DCT_START_ADDR:
+            if (!dct_busy && (data.ui & PE_BATCH_START)) {
+                dct_irq = data.ui & PE_BATCH_IRQ_ENABLE;
+                dct_busy = true;
+                dct_finished = false;
+                dct_start_event.notify(SC_ZERO_TIME);
+            }
+            access = access_delay(register_delay);
+            break;
+        default:
+            std::cerr << "WRITE Error! CordicPE::write_word (" << name() << "): address 0x"
+                    << std::setfill('0') << std::setw(8) << std::hex << addr
+                    << std::dec << " is not valid" << std::endl;
+        }
+        return access;
+    }
 };
 
+typedef CordicPE<16, 8, 9, 7> PE;
+// reduced and extended precision CORDIC accelerators next to the default PE
+typedef CordicPE<12, 4, 9, 5> PE_lp;
+typedef CordicPE<24, 8, 9, 16> PE_hp;
+
 #endif
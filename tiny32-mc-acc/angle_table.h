@@ -1,12 +1,66 @@
 #ifndef ANGLE_TABLE_H
 #define ANGLE_TABLE_H
 
-#define ANGLE0 45
-#define ANGLE1 26.6
-#define ANGLE2 14.0
-#define ANGLE3 7.1
-#define ANGLE4 3.6
-#define ANGLE5 1.8
-#define ANGLE6 0.9
+// CORDIC constants, evaluated at compile time so that every precision
+// configuration of the PE gets the table and gain matching its iteration
+// count:
+//   angle(i) = atan(2^-i) in degrees
+//   gain(n)  = prod_{i<n} 1 / sqrt(1 + 2^-2i)
+namespace cordic {
+
+constexpr double PI = 3.14159265358979323846;
+
+// 2^-i
+constexpr double pow2_neg(unsigned int i) {
+    double p = 1.0;
+    for (unsigned int k = 0; k < i; ++k) {
+        p /= 2.0;
+    }
+    return p;
+}
+
+// Taylor series of atan(x), converges quickly for |x| <= 1/2
+constexpr double atan_series(double x) {
+    double sum = 0.0;
+    double power = x;
+    for (int n = 0; n < 64; ++n) {
+        sum += ((n % 2) ? -power : power) / (2 * n + 1);
+        power *= x * x;
+    }
+    return sum;
+}
+
+constexpr double angle(unsigned int i) {
+    return i == 0 ? 45.0 : atan_series(pow2_neg(i)) * 180.0 / PI;
+}
+
+constexpr double sqrt_newton(double x) {
+    double r = x > 1.0 ? x : 1.0;
+    for (int n = 0; n < 64; ++n) {
+        r = 0.5 * (r + x / r);
+    }
+    return r;
+}
+
+constexpr double gain(unsigned int iterations) {
+    double k = 1.0;
+    for (unsigned int i = 0; i < iterations; ++i) {
+        k /= sqrt_newton(1.0 + pow2_neg(2 * i));
+    }
+    return k;
+}
+
+template <unsigned int N>
+struct angle_table {
+    double angle[N];
+
+    constexpr angle_table() : angle() {
+        for (unsigned int i = 0; i < N; ++i) {
+            angle[i] = cordic::angle(i);
+        }
+    }
+};
+
+}  // namespace cordic
 
 #endif
@@ -0,0 +1,246 @@
+#ifndef RISCV_VP_BUS_PROFILE_H
+#define RISCV_VP_BUS_PROFILE_H
+
+#include <systemc>
+
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/simple_target_socket.h>
+
+#include "bus.h"
+#include "core/common/bus_lock_if.h"
+
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Transaction statistics per initiator/target pair of the platform bus.
+// Targets are resolved from the bus port mappings, addresses outside all
+// of them are accounted to an extra "unmapped" target.
+struct BusProfile {
+	struct stats {
+		uint64_t reads = 0;
+		uint64_t writes = 0;
+		uint64_t read_bytes = 0;
+		uint64_t write_bytes = 0;
+		sc_core::sc_time delay = sc_core::SC_ZERO_TIME;  // annotated plus waited
+	};
+
+	std::vector<std::string> initiators;
+	std::vector<std::pair<std::string, PortMapping *>> targets;
+	std::vector<std::vector<stats>> pairs;      // [initiator][target]
+	std::vector<sc_core::sc_time> lock_wait;    // [initiator]
+
+	BusProfile(const std::vector<std::string> &initiators,
+	           const std::vector<std::pair<std::string, PortMapping *>> &targets)
+	    : initiators(initiators),
+	      targets(targets),
+	      pairs(initiators.size(), std::vector<stats>(targets.size() + 1)),
+	      lock_wait(initiators.size(), sc_core::SC_ZERO_TIME) {}
+
+	unsigned target_of(uint64_t addr) const {
+		for (unsigned t = 0; t < targets.size(); ++t) {
+			if (targets[t].second->contains(addr))
+				return t;
+		}
+		return targets.size();
+	}
+
+	std::string target_name(unsigned t) const {
+		return t < targets.size() ? targets[t].first : "unmapped";
+	}
+
+	// target is resolved by the caller before the bus translates the
+	// transaction address to the target local one
+	void record(unsigned initiator, unsigned target, const tlm::tlm_generic_payload &trans,
+	            const sc_core::sc_time &delay) {
+		stats &s = pairs[initiator][target];
+		if (trans.get_command() == tlm::TLM_READ_COMMAND) {
+			s.reads++;
+			s.read_bytes += trans.get_data_length();
+		} else if (trans.get_command() == tlm::TLM_WRITE_COMMAND) {
+			s.writes++;
+			s.write_bytes += trans.get_data_length();
+		}
+		s.delay += delay;
+	}
+
+	static double ns(const sc_core::sc_time &t) {
+		return t.to_seconds() * 1e9;
+	}
+
+	void report(std::ostream &os) const {
+		os << "bus profile:" << std::endl;
+		os << std::left << std::setw(10) << "initiator" << std::setw(10) << "target" << std::right << std::setw(12)
+		   << "reads" << std::setw(12) << "writes" << std::setw(14) << "read bytes" << std::setw(14) << "write bytes"
+		   << std::setw(16) << "delay [ns]" << std::endl;
+		for (unsigned i = 0; i < initiators.size(); ++i) {
+			for (unsigned t = 0; t <= targets.size(); ++t) {
+				const stats &s = pairs[i][t];
+				if (s.reads == 0 && s.writes == 0)
+					continue;
+				os << std::left << std::setw(10) << initiators[i] << std::setw(10) << target_name(t) << std::right
+				   << std::setw(12) << s.reads << std::setw(12) << s.writes << std::setw(14) << s.read_bytes
+				   << std::setw(14) << s.write_bytes << std::setw(16) << ns(s.delay) << std::endl;
+			}
+		}
+		for (unsigned i = 0; i < initiators.size(); ++i) {
+			os << "  " << initiators[i] << " blocked on bus lock = " << lock_wait[i] << std::endl;
+		}
+	}
+
+	void write_csv(std::ostream &os) const {
+		os << "initiator,target,reads,writes,read_bytes,write_bytes,delay_ns,lock_wait_ns" << std::endl;
+		for (unsigned i = 0; i < initiators.size(); ++i) {
+			for (unsigned t = 0; t <= targets.size(); ++t) {
+				const stats &s = pairs[i][t];
+				os << initiators[i] << "," << target_name(t) << "," << s.reads << "," << s.writes << ","
+				   << s.read_bytes << "," << s.write_bytes << "," << ns(s.delay) << "," << ns(lock_wait[i])
+				   << std::endl;
+			}
+		}
+	}
+
+	void write_json(std::ostream &os) const {
+		os << "{\n  \"pairs\": [";
+		bool first = true;
+		for (unsigned i = 0; i < initiators.size(); ++i) {
+			for (unsigned t = 0; t <= targets.size(); ++t) {
+				const stats &s = pairs[i][t];
+				os << (first ? "\n" : ",\n") << "    {\"initiator\": \"" << initiators[i] << "\", \"target\": \""
+				   << target_name(t) << "\", \"reads\": " << s.reads << ", \"writes\": " << s.writes
+				   << ", \"read_bytes\": " << s.read_bytes << ", \"write_bytes\": " << s.write_bytes
+				   << ", \"delay_ns\": " << ns(s.delay) << "}";
+				first = false;
+			}
+		}
+		os << "\n  ],\n  \"lock_wait_ns\": {";
+		for (unsigned i = 0; i < initiators.size(); ++i) {
+			os << (i ? ", " : "") << "\"" << initiators[i] << "\": " << ns(lock_wait[i]);
+		}
+		os << "}\n}" << std::endl;
+	}
+};
+
+// Pass-through module between an initiator and its bus target socket. The
+// recorded delay is what the transaction added to the annotated delay plus
+// the simulation time the initiator spent inside b_transport. An
+// approximately-timed transaction records the time from BEGIN_REQ to
+// BEGIN_RESP, the initiator itself is not blocked meanwhile.
+struct BusProbe : public sc_core::sc_module {
+	tlm_utils::simple_target_socket<BusProbe> tsock;
+	tlm_utils::simple_initiator_socket<BusProbe> isock;
+
+	BusProfile &profile;
+	unsigned initiator;
+
+	BusProbe(sc_core::sc_module_name name, BusProfile &profile, unsigned initiator)
+	    : sc_module(name), profile(profile), initiator(initiator) {
+		tsock.register_b_transport(this, &BusProbe::transport);
+		tsock.register_transport_dbg(this, &BusProbe::transport_dbg);
+		tsock.register_nb_transport_fw(this, &BusProbe::nb_transport_fw);
+		isock.register_nb_transport_bw(this, &BusProbe::nb_transport_bw);
+	}
+
+	void transport(tlm::tlm_generic_payload &trans, sc_core::sc_time &delay) {
+		sc_core::sc_time start = sc_core::sc_time_stamp() + delay;
+		unsigned target = profile.target_of(trans.get_address());
+		isock->b_transport(trans, delay);
+		profile.record(initiator, target, trans, sc_core::sc_time_stamp() + delay - start);
+	}
+
+	unsigned transport_dbg(tlm::tlm_generic_payload &trans) {
+		return isock->transport_dbg(trans);
+	}
+
+	tlm::tlm_sync_enum nb_transport_fw(tlm::tlm_generic_payload &trans, tlm::tlm_phase &phase,
+	                                   sc_core::sc_time &delay) {
+		if (phase == tlm::BEGIN_REQ)
+			pending[&trans] = {profile.target_of(trans.get_address()), sc_core::sc_time_stamp() + delay};
+		auto status = isock->nb_transport_fw(trans, phase, delay);
+		if (status == tlm::TLM_COMPLETED || (status == tlm::TLM_UPDATED && phase == tlm::BEGIN_RESP))
+			finish(trans, delay);
+		return status;
+	}
+
+	tlm::tlm_sync_enum nb_transport_bw(tlm::tlm_generic_payload &trans, tlm::tlm_phase &phase,
+	                                   sc_core::sc_time &delay) {
+		if (phase == tlm::BEGIN_RESP)
+			finish(trans, delay);
+		return tsock->nb_transport_bw(trans, phase, delay);
+	}
+
+   private:
+	// approximately-timed transactions between BEGIN_REQ and BEGIN_RESP
+	std::map<tlm::tlm_generic_payload *, std::pair<unsigned, sc_core::sc_time>> pending;
+
+	void finish(tlm::tlm_generic_payload &trans, const sc_core::sc_time &delay) {
+		auto it = pending.find(&trans);
+		if (it == pending.end())
+			return;
+		profile.record(initiator, it->second.first, trans, sc_core::sc_time_stamp() + delay - it->second.second);
+		pending.erase(it);
+	}
+};
+
+// bus_lock_if proxy of one initiator, accounts the time it waits for
+// another hart to release the bus lock, either before an access or when
+// acquiring the lock itself
+struct BusLockProbe : public bus_lock_if {
+	std::shared_ptr<bus_lock_if> lock_;
+	BusProfile &profile;
+	unsigned initiator;
+
+	BusLockProbe(std::shared_ptr<bus_lock_if> lock, BusProfile &profile, unsigned initiator)
+	    : lock_(lock), profile(profile), initiator(initiator) {}
+
+	void lock(unsigned hart_id) override {
+		sc_core::sc_time start = sc_core::sc_time_stamp();
+		lock_->lock(hart_id);
+		profile.lock_wait[initiator] += sc_core::sc_time_stamp() - start;
+	}
+
+	void unlock(unsigned hart_id) override {
+		lock_->unlock(hart_id);
+	}
+
+	bool is_locked() override {
+		return lock_->is_locked();
+	}
+
+	bool is_locked(unsigned hart_id) override {
+		return lock_->is_locked(hart_id);
+	}
+
+	void wait_until_unlocked() override {
+		sc_core::sc_time start = sc_core::sc_time_stamp();
+		lock_->wait_until_unlocked();
+		profile.lock_wait[initiator] += sc_core::sc_time_stamp() - start;
+	}
+};
+
+// Connects an initiator socket to a bus target socket, through a BusProbe
+// if profiling is enabled.
+template <typename INITIATOR_SOCKET, typename TARGET_SOCKET>
+void bind_profiled(BusProfile *profile, unsigned initiator, INITIATOR_SOCKET &isock, TARGET_SOCKET &tsock) {
+	if (!profile) {
+		isock.bind(tsock);
+		return;
+	}
+	std::string name = "BusProbe-" + profile->initiators[initiator];
+	BusProbe *probe = new BusProbe(name.c_str(), *profile, initiator);
+	isock.bind(probe->tsock);
+	probe->isock.bind(tsock);
+}
+
+inline std::shared_ptr<bus_lock_if> profiled_lock(BusProfile *profile, unsigned initiator,
+                                                  std::shared_ptr<bus_lock_if> lock) {
+	if (!profile)
+		return lock;
+	return std::make_shared<BusLockProbe>(lock, *profile, initiator);
+}
+
+#endif
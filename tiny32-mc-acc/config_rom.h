@@ -0,0 +1,66 @@
+#ifndef RISCV_VP_CONFIG_ROM_H
+#define RISCV_VP_CONFIG_ROM_H
+
+#include <systemc>
+
+#include <tlm_utils/simple_target_socket.h>
+
+#include <cstring>
+#include <vector>
+
+// Read-only description of the platform for the guest, one 32-bit word
+// per entry. Guest code finds the number of harts and the generated PE
+// address map here instead of hard coding them.
+struct ConfigROM : public sc_core::sc_module {
+	tlm_utils::simple_target_socket<ConfigROM> tsock;
+
+	enum {
+		MAGIC_ADDR = 0x00,
+		HARTS_ADDR = 0x04,
+		PES_ADDR = 0x08,
+		PE_BASE_ADDR = 0x0c,    // PE i is at PE_BASE + i * PE_STRIDE
+		PE_STRIDE_ADDR = 0x10,
+		PE_IRQ_ADDR = 0x14,     // interrupt of PE i is PE_IRQ + i
+		PE_LP_BASE_ADDR = 0x18,
+		PE_HP_BASE_ADDR = 0x1c,
+		DMA_BASE_ADDR = 0x20,
+		DMA_IRQ_ADDR = 0x24,    // DMA completion for hart i is DMA_IRQ + i
+		POOL_BASE_ADDR = 0x28,  // PE pool, port i at POOL_BASE + 0x1000 + i * 0x40
+		POOL_PORTS_ADDR = 0x2c,
+		DMA_CHANNELS_ADDR = 0x30,  // DMA channel c at DMA_BASE + 0x400 + c * 0x40
+		NUM_WORDS = 13,
+	};
+
+	static const uint32_t MAGIC = 0x30474643;  // "CFG0"
+
+	std::vector<uint32_t> words;
+
+	ConfigROM(sc_core::sc_module_name) : words(NUM_WORDS, 0) {
+		tsock.register_b_transport(this, &ConfigROM::transport);
+		words[MAGIC_ADDR / 4] = MAGIC;
+	}
+
+	void set(unsigned addr, uint32_t value) {
+		words[addr / 4] = value;
+	}
+
+	void transport(tlm::tlm_generic_payload &trans, sc_core::sc_time &delay) {
+		auto addr = trans.get_address();
+		auto len = trans.get_data_length();
+
+		if (trans.get_command() != tlm::TLM_READ_COMMAND) {
+			trans.set_response_status(tlm::TLM_COMMAND_ERROR_RESPONSE);
+			return;
+		}
+		if (addr + len > words.size() * 4) {
+			trans.set_response_status(tlm::TLM_ADDRESS_ERROR_RESPONSE);
+			return;
+		}
+		memcpy(trans.get_data_ptr(), (uint8_t *)words.data() + addr, len);
+		trans.set_response_status(tlm::TLM_OK_RESPONSE);
+
+		(void)delay;  // zero delay
+	}
+};
+
+#endif
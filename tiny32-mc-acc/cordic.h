@@ -0,0 +1,116 @@
+#ifndef CORDIC_H
+#define CORDIC_H
+
+#include "angle_table.h"
+#include "defines.h"
+
+// Bit-accurate model of the CORDIC datapath for one precision. The stages
+// are exposed individually so that the pipelined PE can register them.
+//   rotation mode:  (x, y, z) -> (x cos z - y sin z, x sin z + y cos z, 0)
+//   vectoring mode: (x, y, z) -> (sqrt(x^2 + y^2), 0, z + atan2(y, x))
+// Angles are in degrees.
+template <typename data_type, typename angle_type, unsigned int ITER>
+struct CORDIC_datapath {
+    typedef CORDIC_output<data_type, angle_type> output_t;
+
+    static constexpr cordic::angle_table<ITER> angles{};
+    static constexpr double GAIN = cordic::gain(ITER);
+
+    static output_t one(data_type x_0, data_type y_0, angle_type theta_0, bool mode, unsigned int SFL, angle_type theta_const) {
+        data_type tmp_x;
+        data_type tmp_y;
+        angle_type tmp_theta;
+        data_type x;
+        data_type y;
+        angle_type theta;
+        output_t o_data;
+
+        tmp_x = x_0 >> SFL;
+        tmp_y = y_0 >> SFL;
+        if (mode) { // vectoring mode
+            if (y_0 > 0) { // rotate negative degree
+                tmp_x = -tmp_x;
+                tmp_theta = theta_const;
+            } else {     // rotate positive degree
+                tmp_y = -tmp_y;
+                tmp_theta = -theta_const;
+            }
+        } else { // rotation mode
+            if (theta_0 > 0) { // rotate positive degree
+                tmp_y = -tmp_y;
+                tmp_theta = -theta_const;
+            } else {           // rotate negative degree
+                tmp_x = -tmp_x;
+                tmp_theta = theta_const;
+            }
+        }
+        x = x_0 + tmp_y;
+        y = tmp_x + y_0;
+        theta = theta_0 + tmp_theta;
+        o_data.x = x;
+        o_data.y = y;
+        o_data.theta = theta;
+        return o_data;
+    }
+
+    // input correction, brings the vector into the convergence range
+    static output_t correction(data_type x_0, data_type y_0, angle_type theta_0, bool mode) {
+        data_type cor_x;
+        data_type cor_y;
+        angle_type cor_theta;
+        output_t o_data;
+
+        if (mode) {   // vectoring mode
+            if (y_0 > 0) {
+                cor_x = y_0; // rotate -90 degree
+                cor_y = -x_0;
+                cor_theta = theta_0 + 90.0;
+            } else {
+                cor_x = -y_0; // rotate 90 degree
+                cor_y = x_0;
+                cor_theta = theta_0 - 90.0;
+            }
+        } else {     // rotation mode
+            if(theta_0 > 0) {
+                cor_x = -y_0; // rotate 90 degree
+                cor_y = x_0;
+                cor_theta = theta_0 - 90.0;
+            } else {
+                cor_x = y_0;  // rotate -90 degree
+                cor_y = -x_0;
+                cor_theta = theta_0 + 90.0;
+            }
+        }
+        o_data.x = cor_x;
+        o_data.y = cor_y;
+        o_data.theta = cor_theta;
+        return o_data;
+    }
+
+    static output_t stage(unsigned int stage, output_t in, bool mode) {
+        return one(in.x, in.y, in.theta, mode, stage, angles.angle[stage]);
+    }
+
+    static output_t scale(output_t in) {
+        static const data_type factor = GAIN;
+        in.x = in.x * factor;
+        in.y = in.y * factor;
+        return in;
+    }
+
+    static output_t run(data_type x_0, data_type y_0, angle_type theta_0, bool mode) {
+        output_t out = correction(x_0, y_0, theta_0, mode);
+        for (unsigned int i = 0; i < ITER; ++i) {
+            out = stage(i, out, mode);
+        }
+        return scale(out);
+    }
+};
+
+template <typename data_type, typename angle_type, unsigned int ITER>
+constexpr cordic::angle_table<ITER> CORDIC_datapath<data_type, angle_type, ITER>::angles;
+
+template <typename data_type, typename angle_type, unsigned int ITER>
+constexpr double CORDIC_datapath<data_type, angle_type, ITER>::GAIN;
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef CORDIC_CHECK_H
+#define CORDIC_CHECK_H
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <systemc>
+
+#include "cordic.h"
+#include "fixed_int.h"
+
+// Runs the CORDIC datapath of one PE configuration with the sc_fixed and
+// with the fixed_int backend on the same inputs and compares the results
+// bit by bit. Every angle code is visited (strided for words wider than 16
+// bit) against a set of data codes covering zero, the smallest and largest
+// magnitudes, powers of two and pseudo random values. Returns the number
+// of mismatching jobs. Rotation and vectoring mode are checked alike.
+template <int W, int DATA_I, int ANGLE_I, unsigned int ITER>
+unsigned long cordic_backend_check(std::ostream &os) {
+    typedef CORDIC_datapath<sc_dt::sc_fixed<W, DATA_I>, sc_dt::sc_fixed<W, ANGLE_I>, ITER> sc_path;
+    typedef CORDIC_datapath<fixed_int<W, DATA_I>, fixed_int<W, ANGLE_I>, ITER> int_path;
+    typedef fixed_int<W, DATA_I> int_data;
+    typedef fixed_int<W, ANGLE_I> int_angle;
+
+    const int64_t half = (int64_t)1 << (W - 1);
+    std::vector<int64_t> data_codes = {0, 1, -1, half - 1, -half};
+    for (int b = 1; b < W - 1; ++b) {
+        data_codes.push_back((int64_t)1 << b);
+        data_codes.push_back(-((int64_t)1 << b));
+    }
+    uint32_t lcg = 12345;
+    for (int n = 0; n < 16; ++n) {
+        lcg = lcg * 1103515245 + 12345;
+        data_codes.push_back((int64_t)(lcg >> 8) % half);
+    }
+    const int64_t angle_step = W > 16 ? ((int64_t)1 << (W - 16)) : 1;
+
+    // convert all inputs up front so that the timing below only covers
+    // the datapath
+    std::vector<int_data> int_x, int_y;
+    std::vector<int_angle> int_z;
+    std::vector<bool> mode;
+    for (int64_t z = -half; z < half; z += angle_step) {
+        for (size_t i = 0; i < data_codes.size(); i += 2) {
+            int_x.push_back(int_data::from_raw(data_codes[i]));
+            int_y.push_back(int_data::from_raw(data_codes[(i + 1) % data_codes.size()]));
+            int_z.push_back(int_angle::from_raw(z));
+            mode.push_back((i / 2) % 2);  // alternate rotation and vectoring
+        }
+    }
+    std::vector<typename sc_path::output_t> sc_out(int_z.size());
+    std::vector<typename int_path::output_t> int_out(int_z.size());
+    std::vector<sc_dt::sc_fixed<W, DATA_I>> sc_x, sc_y;
+    std::vector<sc_dt::sc_fixed<W, ANGLE_I>> sc_z;
+    for (size_t n = 0; n < int_z.size(); ++n) {
+        sc_x.push_back(int_x[n].to_double());
+        sc_y.push_back(int_y[n].to_double());
+        sc_z.push_back(int_z[n].to_double());
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < sc_z.size(); ++n) {
+        sc_out[n] = sc_path::run(sc_x[n], sc_y[n], sc_z[n], mode[n]);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < int_z.size(); ++n) {
+        int_out[n] = int_path::run(int_x[n], int_y[n], int_z[n], mode[n]);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    unsigned long mismatches = 0;
+    for (size_t n = 0; n < int_z.size(); ++n) {
+        if (sc_out[n].x.to_double() != int_out[n].x.to_double() ||
+            sc_out[n].y.to_double() != int_out[n].y.to_double() ||
+            sc_out[n].theta.to_double() != int_out[n].theta.to_double()) {
+            if (mismatches < 10) {
+                os << "  mismatch for (" << int_x[n] << ", " << int_y[n] << ", " << int_z[n] << "): sc_fixed ("
+                   << sc_out[n].x.to_double() << ", " << sc_out[n].y.to_double() << ", " << sc_out[n].theta.to_double()
+                   << ") fixed_int (" << int_out[n].x << ", " << int_out[n].y << ", " << int_out[n].theta << ")"
+                   << std::endl;
+            }
+            mismatches++;
+        }
+    }
+
+    double sc_s = std::chrono::duration<double>(t1 - t0).count();
+    double int_s = std::chrono::duration<double>(t2 - t1).count();
+    os << "CORDIC<" << W << ", " << DATA_I << ", " << ANGLE_I << ", " << ITER << ">: " << int_z.size()
+       << " jobs, " << mismatches << " mismatches, sc_fixed " << sc_s << " s, fixed_int " << int_s << " s ("
+       << (int_s > 0 ? sc_s / int_s : 0.0) << "x)" << std::endl;
+    return mismatches;
+}
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef CORDIC_DCT_H
+#define CORDIC_DCT_H
+
+#include <cmath>
+#include <vector>
+
+#include "cordic.h"
+
+// Orthonormal DCT-II of one row of m samples on the CORDIC datapath,
+//   X[j] = s(j) * sum_k x[k] cos(180 (k + 0.5) j / m degrees),
+//   s(0) = 1/sqrt(m), s(j) = sqrt(2/m),
+// i.e. the transform of the basic-dct kernel. All products with cosines
+// are rotation mode passes through datapath_t::run, butterflies are adds
+// in data_type and the remaining constant factors are coef_type multiplies.
+//
+//   m == 8:    Loeffler factorization, 3 rotations
+//   m even:    the even outputs are the DCT of the m/2 sums x[k] + x[m-1-k],
+//              the odd outputs the DCT-IV of the differences, with one
+//              rotation per pair of differences
+//   m odd:     direct evaluation, one rotation per pair of samples
+//
+// The transform runs unnormalized with a block exponent: the row is shifted
+// right only as far as the datapath range needs for the sum of the input
+// magnitudes (which bounds every intermediate value, times the CORDIC
+// growth), and the normalization is applied to the outputs. Rows of small
+// samples keep all their fraction bits.
+template <typename data_type, typename angle_type, typename coef_type, unsigned int ITER>
+struct CORDIC_dct {
+    typedef CORDIC_datapath<data_type, angle_type, ITER> datapath_t;
+
+    // Transforms in[0..m-1] into out[0..m-1] and returns the number of
+    // datapath passes. range is the magnitude data_type holds.
+    static unsigned int transform(const data_type *in, data_type *out, unsigned int m, double range) {
+        unsigned int rotations = 0;
+        double sum = 0;
+        for (unsigned int k = 0; k < m; ++k) {
+            sum += std::fabs((double) in[k]);
+        }
+        int shift = 0;
+        while (sum / datapath_t::GAIN >= range) {
+            sum /= 2;
+            shift++;
+        }
+        std::vector<data_type> x(in, in + m);
+        for (unsigned int k = 0; k < m; ++k) {
+            x[k] = x[k] >> shift;
+        }
+        dct(x.data(), out, m, rotations);
+        // normalization times 2^shift as a coefficient in [0.5, 1) and the
+        // left shift that remains, so the product is rounded only once
+        for (int dc = 0; dc < 2; ++dc) {
+            double f = std::ldexp(std::sqrt((dc ? 1.0 : 2.0) / m), shift);
+            int e = 0;
+            while (f >= 1.0) {
+                f /= 2;
+                e++;
+            }
+            const coef_type c = f;
+            for (unsigned int j = dc ? 0 : 1; j < (dc ? 1 : m); ++j) {
+                out[j] = out[j] * c;
+                out[j] = out[j] << e;
+            }
+        }
+        return rotations;
+    }
+
+    // x cos(deg) - y sin(deg), angle reduced to [-180, 180]; a zero angle
+    // needs no datapath pass
+    static data_type rotate(data_type x, data_type y, double deg, unsigned int &rotations) {
+        deg = std::fmod(deg, 360.0);
+        if (deg > 180.0) deg -= 360.0;
+        if (deg < -180.0) deg += 360.0;
+        if (deg == 0.0) return x;
+        rotations++;
+        return datapath_t::run(x, y, (angle_type) deg, false).x;
+    }
+
+    // unnormalized DCT-II, X[j] = sum_k x[k] cos(180 (k + 0.5) j / m)
+    static void dct(const data_type *x, data_type *X, unsigned int m, unsigned int &rotations) {
+        if (m == 8) {
+            loeffler8(x, X, rotations);
+        } else if (m % 2 == 0 && m > 2) {
+            unsigned int h = m / 2;
+            std::vector<data_type> s(h), d(h), S(h), D(h);
+            for (unsigned int k = 0; k < h; ++k) {
+                s[k] = x[k] + x[m - 1 - k];
+                d[k] = x[k] - x[m - 1 - k];
+            }
+            dct(s.data(), S.data(), h, rotations);
+            dct4(d.data(), D.data(), h, rotations);
+            for (unsigned int k = 0; k < h; ++k) {
+                X[2 * k] = S[k];
+                X[2 * k + 1] = D[k];
+            }
+        } else {
+            // cos of sample m-1-k is (-1)^j times the one of sample k
+            for (unsigned int j = 0; j < m; ++j) {
+                data_type acc = 0;
+                for (unsigned int k = 0; k < m / 2; ++k) {
+                    data_type pair = (j % 2) ? data_type(x[k] - x[m - 1 - k]) : data_type(x[k] + x[m - 1 - k]);
+                    acc = acc + rotate(pair, 0, 180.0 * (k + 0.5) * j / m, rotations);
+                }
+                if (m % 2) {
+                    unsigned int k = m / 2;
+                    if (j % 4 == 0) acc = acc + x[k];
+                    if (j % 4 == 2) acc = acc - x[k];
+                }
+                X[j] = acc;
+            }
+        }
+    }
+
+    // unnormalized DCT-IV, X[j] = sum_k x[k] cos(45 (2k + 1)(2j + 1) / h).
+    // Samples k and h-1-k share one rotation: the cosine of the latter is
+    // (-1)^j times the sine of the former.
+    static void dct4(const data_type *x, data_type *X, unsigned int h, unsigned int &rotations) {
+        for (unsigned int j = 0; j < h; ++j) {
+            data_type acc = 0;
+            for (unsigned int k = 0; k < h / 2; ++k) {
+                data_type y = (j % 2) ? data_type(x[h - 1 - k]) : data_type(-x[h - 1 - k]);
+                acc = acc + rotate(x[k], y, 45.0 * (2 * k + 1) * (2 * j + 1) / h, rotations);
+            }
+            if (h % 2) {
+                unsigned int k = h / 2;
+                acc = acc + rotate(x[k], 0, 45.0 * (2 * k + 1) * (2 * j + 1) / h, rotations);
+            }
+            X[j] = acc;
+        }
+    }
+
+    // Loeffler, Ligtenberg, Moschytz 8-point DCT: the even half is a 4-point
+    // DCT with one rotation by 22.5 degrees, the odd half rotates the
+    // differences by 33.75 and 11.25 degrees and finishes with butterflies.
+    // Outputs 1, 4 and 7 take a 1/sqrt(2) scaling.
+    static void loeffler8(const data_type *x, data_type *X, unsigned int &rotations) {
+        const coef_type r = 1.0 / std::sqrt(2.0);
+
+        data_type t0 = x[0] + x[7], t7 = x[0] - x[7];
+        data_type t1 = x[1] + x[6], t6 = x[1] - x[6];
+        data_type t2 = x[2] + x[5], t5 = x[2] - x[5];
+        data_type t3 = x[3] + x[4], t4 = x[3] - x[4];
+
+        // even part
+        data_type t10 = t0 + t3, t13 = t0 - t3;
+        data_type t11 = t1 + t2, t12 = t1 - t2;
+        X[0] = t10 + t11;
+        X[4] = (t10 - t11) * r;
+        CORDIC_output<data_type, angle_type> e = datapath_t::run(t13, t12, (angle_type) -22.5, false);
+        X[2] = e.x;
+        X[6] = -e.y;
+        rotations++;
+
+        // odd part
+        CORDIC_output<data_type, angle_type> a = datapath_t::run(t4, t7, (angle_type) -33.75, false);
+        CORDIC_output<data_type, angle_type> b = datapath_t::run(t5, t6, (angle_type) -11.25, false);
+        rotations += 2;
+        data_type p = a.x + b.y;
+        data_type q = a.y + b.x;
+        X[3] = a.y - b.x;
+        X[5] = a.x - b.y;
+        X[1] = (p + q) * r;
+        X[7] = (q - p) * r;
+    }
+};
+
+#endif
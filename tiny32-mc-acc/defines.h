@@ -1,13 +1,27 @@
 #ifndef _DEFINES_H
 #define _DEFINES_H
 
-typedef sc_dt::sc_fixed<16, 8> data_t;
-typedef sc_dt::sc_fixed<16, 9> angle_t;
-typedef struct CORDIC_output {
-    data_t x;
-    data_t y;
-    angle_t theta;
-} CORDIC_output_t;
+#include "fixed_int.h"
+
+// Fixed-point type of the PE datapath. Building with PE_NATIVE_FIXED
+// selects the bit-exact int32_t backend instead of sc_fixed.
+#ifdef PE_NATIVE_FIXED
+template <int W, int I> using pe_fixed = fixed_int<W, I>;
+#else
+template <int W, int I> using pe_fixed = sc_dt::sc_fixed<W, I>;
+#endif
+
+template <typename data_type, typename angle_type>
+struct CORDIC_output {
+    data_type x;
+    data_type y;
+    angle_type theta;
+};
+
+// default PE precision
+typedef pe_fixed<16, 8> data_t;
+typedef pe_fixed<16, 9> angle_t;
+typedef CORDIC_output<data_t, angle_t> CORDIC_output_t;
 
 // PE inner transport addresses
 const int PE_INPUT_A_ADDR = 0x00000000;
@@ -16,9 +30,85 @@ const int PE_INPUT_Z_ADDR = 0x00000008;
 const int PE_OUTPUT_A_ADDR = 0x0000000c;
 const int PE_OUTPUT_B_ADDR = 0x00000010;
 const int PE_OUTPUT_Z_ADDR = 0x00000014;
+const int PE_MODE_ADDR = 0x00000018;
+// FIFO levels: bits 15..0 free input slots, bits 31..16 results ready
+const int PE_FIFO_STATUS_ADDR = 0x0000001c;
+
+// PE poll interface: STATUS never blocks, a guest that waits for
+// PE_STATUS_RESULT before reading the outputs and for PE_STATUS_ROOM
+// before writing Z never blocks inside the bus either. With
+// PE_CTRL_NONBLOCK set the operand and result registers do not block at
+// all: a read without a result returns 0 and sets UNDERRUN, a write to a
+// full input fifo is dropped and sets OVERRUN. Writing 1 clears a sticky
+// bit.
+const int PE_STATUS_ADDR = 0x00000060;
+const int PE_CTRL_ADDR = 0x00000064;
+
+// PE_STATUS_ADDR bits
+const int PE_STATUS_RESULT = 0x1;  // a complete {a, b, z} result is ready
+const int PE_STATUS_ROOM = 0x2;    // a complete {a, b, z} job fits
+const int PE_STATUS_UNDERRUN = 0x4;
+const int PE_STATUS_OVERRUN = 0x8;
+
+// PE_CTRL_ADDR bits
+const int PE_CTRL_NONBLOCK = 0x1;
+
+// PE_MODE_ADDR values, latched per job when its Z operand is written
+const int PE_MODE_ROTATION = 0;
+const int PE_MODE_VECTORING = 1;
+
+// PE packed job window: a and b as 16-bit Q fields with the integer bits
+// of the data word (Q8.8 on the default PE) in one word, a in bits 15..0,
+// z as a 16-bit Q field with the integer bits of the angle word (Q9.7) in a
+// half-word. Writing Z submits the job, reading OUT_Z pops the z result,
+// so a job moves 6 bytes each way, e.g. one 6-byte burst per direction.
+const int PE_PACKED_AB_ADDR = 0x00000050;
+const int PE_PACKED_Z_ADDR = 0x00000054;
+const int PE_PACKED_OUT_AB_ADDR = 0x00000058;
+const int PE_PACKED_OUT_Z_ADDR = 0x0000005c;
+
+// PE batch interface: fill PE_BATCH_IN with COUNT {a, b, z} triples, write
+// START and collect the {a, b, z} results from PE_BATCH_OUT once STATUS
+// reports done
+const int PE_BATCH_COUNT_ADDR = 0x00000020;
+const int PE_BATCH_START_ADDR = 0x00000024;
+const int PE_BATCH_STATUS_ADDR = 0x00000028;
+const int PE_BATCH_IN_ADDR = 0x00001000;
+const int PE_BATCH_OUT_ADDR = 0x00004000;
+const int PE_BATCH_DEPTH = 256;
+
+// PE_BATCH_START_ADDR bits
+const int PE_BATCH_START = 0x1;
+const int PE_BATCH_IRQ_ENABLE = 0x2;
+// PE_BATCH_STATUS_ADDR bits, bits 31..16 hold the number of finished jobs
+const int PE_BATCH_BUSY = 0x1;
+const int PE_BATCH_DONE = 0x2;
+
+// PE DCT mode: write LEN float samples to PE_DCT_IN, START and read LEN
+// orthonormal DCT-II coefficients from PE_DCT_OUT once STATUS reports done.
+// START and STATUS use the PE_BATCH_* bits.
+const int PE_DCT_LEN_ADDR = 0x00000030;
+const int PE_DCT_START_ADDR = 0x00000034;
+const int PE_DCT_STATUS_ADDR = 0x00000038;
+const int PE_DCT_IN_ADDR = 0x00007000;
+const int PE_DCT_OUT_ADDR = 0x00008000;
+const int PE_DCT_MAX_LEN = 256;
+
+// PE DCT coefficient table: writing M fills the table for that length,
+// once STATUS (PE_BATCH_* bits) reports done VALUE returns
+// cos(180 (k + 0.5) j / M degrees) for the (k, j) pair in INDEX
+const int PE_COEF_M_ADDR = 0x00000040;
+const int PE_COEF_STATUS_ADDR = 0x00000044;
+const int PE_COEF_INDEX_ADDR = 0x00000048;  // k in bits 15..0, j in bits 31..16
+const int PE_COEF_VALUE_ADDR = 0x0000004c;
+const int PE_COEF_MAX_M = 1024;
+
+// PE performance counter block, see perf_counters.h for the layout
+const int PE_PERF_ADDR = 0x00000100;
 
 union word {
   float f;
+  unsigned int ui;
   unsigned char uc[4];
 };
 
@@ -6,26 +6,85 @@
 #include <tlm_utils/simple_initiator_socket.h>
 #include <tlm_utils/simple_target_socket.h>
 
+#include "bus_profile.h"
+#include "core/common/bus_lock_if.h"
+#include "core/common/dmi.h"
+#include "dma_flow.h"
+#include "perf_counters.h"
+
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <string>
 #include <unordered_map>
-#include <array>
-
+#include <vector>
+
+// DMA with independent channels. Every channel has its own register bank,
+// operation and descriptor chain queue and engine, so harts that each use
+// their own channel issue transfers at the same time without a software
+// lock. The channels share isock: a channel owns it for the time of one
+// burst, the next one goes to a waiting channel by round robin (or to the
+// lowest waiting channel with ARB_PRIORITY). A target that keeps a burst
+// waiting, e.g. a PE read before the result is ready, holds up its channel
+// but not the port.
+// The register set at offset 0 is channel 0, channel c is also at
+// CHANNEL_BASE_ADDR + c * CHANNEL_STRIDE.
 struct SimpleDMA : public sc_core::sc_module {
 	tlm_utils::simple_initiator_socket<SimpleDMA> isock;
 	tlm_utils::simple_target_socket<SimpleDMA> tsock;
 
 	interrupt_gateway *plic = 0;
+	// completion of work requested by hart h raises irq_number + h
 	uint32_t irq_number = 0;
-
-	std::array<uint8_t, 4> buffer;
-
-	uint32_t src = 0;
-	uint32_t dst = 0;
-	uint32_t len = 0;
-	uint32_t op = 0;
-	uint32_t stat = 0;
-
-	std::unordered_map<uint64_t, uint32_t *> addr_to_reg;
-
+	unsigned irq_lines = 1;
+
+	// plain memory regions the engine may access directly instead of
+	// issuing bus transactions (bus timing is still annotated)
+	std::vector<MemoryDMI> dmi_ranges;
+	// ISS bus lock of the connector in front of isock, direct memory
+	// accesses wait for it like the bus transactions do
+	std::shared_ptr<bus_lock_if> bus_lock;
+	// direct memory accesses are recorded as the bursts they stand for,
+	// as traffic of profile_initiator
+	BusProfile *profile = nullptr;
+	unsigned profile_initiator = 0;
+
+	// bus timing: every burst costs burst_delay plus beat_delay for each
+	// beat_width bytes it carries
+	unsigned beat_width = 4;
+	sc_core::sc_time beat_delay = sc_core::SC_ZERO_TIME;
+	sc_core::sc_time burst_delay = sc_core::SC_ZERO_TIME;
+	// from the OP_ADDR or DESC_ADDR write to the start of the operation
+	sc_core::sc_time start_delay = sc_core::sc_time(10, sc_core::SC_NS);
+
+	// flow control of the peripherals OP_STREAM can be pointed at
+	struct flow_range {
+		uint64_t start;
+		uint64_t end;
+		dma_flow_if *flow;
+	};
+	std::vector<flow_range> flows;
+
+	// guest visible counters at PERF_ADDR in 10 ns cycles, busy while any
+	// channel executes an operation or a chain, one op per executed
+	// operation, bytes is the sum of their LEN
+	PerfCounters perf;
+
+	// Result of the last OP_ADDR operation is reported in STAT, descriptors
+	// leave the register bank alone:
+	//   OP_MEMSET  fills LEN bytes at DST with the low byte of SRC
+	//   OP_MEMCMP  compares LEN bytes at SRC and DST, STAT = difference of the
+	//              first mismatching bytes (SRC - DST), 0 if equal
+	//   OP_MEMCHR  searches LEN bytes at SRC for the low byte of DST,
+	//              STAT = address of the first match, SRC + LEN if not
+	//              found (0 is a valid match, RAM starts there)
+	//   OP_MEMMOVE like OP_MEMCPY but correct for overlapping regions
+	//   OP_STREAM  feeds LEN bytes at SRC, STREAM_ITEM bytes at a time, to
+	//              the peripheral input at STREAM_IN and stores as many
+	//              items from its output at STREAM_OUT at DST. Items move
+	//              whenever the peripheral's flow control allows, so
+	//              operands and results overlap.
 	enum {
 		OP_NOP = 0,
 		OP_MEMCPY = 1,
@@ -33,85 +92,522 @@ struct SimpleDMA : public sc_core::sc_module {
 		OP_MEMCMP = 3,
 		OP_MEMCHR = 4,
 		OP_MEMMOVE = 5,
+		OP_STREAM = 6,
 	};
 
+	// channel registers, offsets from the channel bank
 	enum {
 		SRC_ADDR = 0,
 		DST_ADDR = 4,
 		LEN_ADDR = 8,
 		OP_ADDR = 12,
 		STAT_ADDR = 16,
+		DESC_ADDR = 20,
+		STATUS_ADDR = 24,
+		HART_ADDR = 28,
+		STREAM_IN_ADDR = 32,
+		STREAM_OUT_ADDR = 36,
+		STREAM_ITEM_ADDR = 40,
 	};
 
-	sc_core::sc_event run_event;
+	enum {
+		CHANNELS_ADDR = 44,  // number of channels, read only
+		PERF_ADDR = 0x100,
+		CHANNEL_BASE_ADDR = 0x400,
+		CHANNEL_STRIDE = 0x40,
+	};
 
-	SC_HAS_PROCESS(SimpleDMA);
+	static const unsigned MAX_CHANNELS = 16;
 
-	SimpleDMA(sc_core::sc_module_name, uint32_t irq_number) : irq_number(irq_number) {
-		tsock.register_b_transport(this, &SimpleDMA::transport);
+	// STATUS_ADDR bits. BUSY is set while an operation or chain is queued
+	// or running on the channel, DONE once the channel has drained all
+	// queued work, both are read only. ERROR is sticky: an unknown
+	// operation, a bus error response or a requesting hart without an
+	// interrupt line, writing ERROR clears it.
+	enum {
+		STATUS_BUSY = 0x1,
+		STATUS_DONE = 0x2,
+		STATUS_ERROR = 0x4,
+	};
+
+	// Scatter-gather descriptor as laid out in guest memory. Writing the
+	// address of the first one to DESC_ADDR queues the chain on the
+	// channel; the engine executes descriptors until next == 0.
+	struct descriptor {
+		uint32_t src;
+		uint32_t dst;
+		uint32_t len;
+		uint32_t op;
+		uint32_t flags;
+		uint32_t next;
+	};
 
-		SC_THREAD(run);
+	// Tail that follows a descriptor with op == OP_STREAM and gives its
+	// STREAM_* operands.
+	struct stream_tail {
+		uint32_t in;
+		uint32_t out;
+		uint32_t item;
+	};
+
+	// flags: DESC_IRQ interrupts the requesting hart, given in bits
+	// 15..8, after this descriptor (always done for the last one)
+	enum {
+		DESC_IRQ = 1,
+		DESC_HART_SHIFT = 8,
+		DESC_HART_MASK = 0xff00,
+	};
 
-		addr_to_reg = {
-		    {SRC_ADDR, &src},
-		    {DST_ADDR, &dst},
-		    {LEN_ADDR, &len},
-		    {OP_ADDR, &op},
+	// isock arbitration between channels with a burst to issue
+	enum arbitration_t {
+		ARB_ROUND_ROBIN,
+		ARB_PRIORITY,
+	};
+	arbitration_t arbitration = ARB_ROUND_ROBIN;
+
+	// operands of one operation, from the registers for OP_ADDR or from a
+	// descriptor
+	struct operation {
+		uint32_t src;
+		uint32_t dst;
+		uint32_t len;
+		uint32_t op;
+		uint32_t stream_in;
+		uint32_t stream_out;
+		uint32_t stream_item;
+	};
+
+	// One register bank and the engine executing its work. HART resets to
+	// the channel number, so a hart using the channel of the same number
+	// gets its completion interrupts without writing it.
+	struct Channel : public sc_core::sc_module {
+		SimpleDMA &dma;
+		unsigned index;
+
+		// internal transfer buffer, one burst moves at most buffer.size() bytes
+		std::vector<uint8_t> buffer;
+		std::vector<uint8_t> cmp_buffer;  // second operand of OP_MEMCMP
+
+		uint32_t src = 0;
+		uint32_t dst = 0;
+		uint32_t len = 0;
+		uint32_t op = 0;
+		uint32_t stat = 0;
+		uint32_t desc = 0;
+		uint32_t hart = 0;    // requester of the next OP_ADDR operation
+		uint32_t status = 0;  // STATUS_* bits
+		uint32_t stream_in = 0;
+		uint32_t stream_out = 0;
+		uint32_t stream_item = 12;
+
+		// a queued descriptor chain and the HART value when it was queued
+		struct chain {
+			uint32_t head;
+			uint32_t hart;
 		};
-	}
 
-	void _copy_block(uint32_t off, uint32_t n) {
-		do_transaction(tlm::TLM_READ_COMMAND, src + off, &buffer[0], n);
-		do_transaction(tlm::TLM_WRITE_COMMAND, dst + off, &buffer[0], n);
-	}
+		bool op_pending = false;
+		uint32_t op_hart = 0;
+		std::deque<chain> chains;
+		bool error = false;           // the current operation failed
+
+		std::unordered_map<uint64_t, uint32_t *> addr_to_reg;
+
+		sc_core::sc_event run_event;
+
+		SC_HAS_PROCESS(Channel);
+
+		Channel(sc_core::sc_module_name name, SimpleDMA &dma, unsigned index, uint32_t burst_size)
+		    : sc_module(name), dma(dma), index(index), buffer(burst_size), cmp_buffer(burst_size), hart(index) {
+			SC_THREAD(run);
+
+			addr_to_reg = {
+			    {SRC_ADDR, &src},
+			    {DST_ADDR, &dst},
+			    {LEN_ADDR, &len},
+			    {OP_ADDR, &op},
+			    {STAT_ADDR, &stat},
+			    {DESC_ADDR, &desc},
+			    {STATUS_ADDR, &status},
+			    {HART_ADDR, &hart},
+			    {STREAM_IN_ADDR, &stream_in},
+			    {STREAM_OUT_ADDR, &stream_out},
+			    {STREAM_ITEM_ADDR, &stream_item},
+			};
+		}
+
+		bool do_transaction(tlm::tlm_command cmd, uint64_t addr, uint8_t *data, unsigned num_bytes) {
+			if (dma.do_transaction(index, cmd, addr, data, num_bytes))
+				return true;
+			error = true;
+			return false;
+		}
 
-	void _perform_memcpy() {
-		auto n = len;
-		uint32_t off = 0;
+		// before a direct access to n bytes at addr: takes the time the
+		// same bursts would have taken on the bus, then waits for the ISS
+		// bus lock, so the access itself happens without time passing
+		void _dmi_access(tlm::tlm_command cmd, uint32_t addr, uint32_t n) {
+			sc_core::sc_time t = sc_core::SC_ZERO_TIME;
+			for (uint32_t off = 0; off < n; off += buffer.size()) {
+				auto k = std::min<uint32_t>(n - off, buffer.size());
+				t += dma.burst_time(k);
+				dma.record_dmi(cmd, addr + off, k, dma.burst_time(k));
+			}
+			dma.dmi_access(index, t);
+		}
 
-		while (n > buffer.size()) {
-			_copy_block(off, buffer.size());
-			n -= buffer.size();
-			off += buffer.size();
+		void _copy_block(const operation &o, uint32_t off, uint32_t n) {
+			do_transaction(tlm::TLM_READ_COMMAND, o.src + off, &buffer[0], n);
+			do_transaction(tlm::TLM_WRITE_COMMAND, o.dst + off, &buffer[0], n);
 		}
 
-		_copy_block(off, n);
-	}
+		void _perform_memcpy(const operation &o) {
+			auto n = o.len;
+			uint32_t off = 0;
+
+			auto s = dma._dmi_ptr(o.src, o.len);
+			auto d = dma._dmi_ptr(o.dst, o.len);
+			if (s && d) {
+				_dmi_access(tlm::TLM_READ_COMMAND, o.src, o.len);
+				_dmi_access(tlm::TLM_WRITE_COMMAND, o.dst, o.len);
+				memcpy(d, s, o.len);
+				return;
+			}
+
+			while (n > buffer.size()) {
+				_copy_block(o, off, buffer.size());
+				n -= buffer.size();
+				off += buffer.size();
+			}
+
+			if (n > 0)
+				_copy_block(o, off, n);
+		}
+
+		void _perform_memmove(const operation &o) {
+			if ((o.dst <= o.src) || (o.dst >= o.src + o.len)) {
+				_perform_memcpy(o);  // forward copy is safe
+				return;
+			}
+
+			auto s = dma._dmi_ptr(o.src, o.len);
+			auto d = dma._dmi_ptr(o.dst, o.len);
+			if (s && d) {
+				_dmi_access(tlm::TLM_READ_COMMAND, o.src, o.len);
+				_dmi_access(tlm::TLM_WRITE_COMMAND, o.dst, o.len);
+				memmove(d, s, o.len);
+				return;
+			}
+
+			// dst overlaps the tail of src, copy backwards
+			auto n = o.len;
+			while (n > 0) {
+				auto k = std::min<uint32_t>(n, buffer.size());
+				n -= k;
+				_copy_block(o, n, k);
+			}
+		}
+
+		void _perform_memset(const operation &o) {
+			auto value = (uint8_t)o.src;
+
+			auto d = dma._dmi_ptr(o.dst, o.len);
+			if (d) {
+				_dmi_access(tlm::TLM_WRITE_COMMAND, o.dst, o.len);
+				memset(d, value, o.len);
+				return;
+			}
+
+			std::fill(buffer.begin(), buffer.end(), value);
+			uint32_t off = 0;
+			while (off < o.len) {
+				auto k = std::min<uint32_t>(o.len - off, buffer.size());
+				do_transaction(tlm::TLM_WRITE_COMMAND, o.dst + off, &buffer[0], k);
+				off += k;
+			}
+		}
+
+		int32_t _compare(const uint8_t *a, const uint8_t *b, uint32_t n) {
+			for (uint32_t i = 0; i < n; ++i) {
+				if (a[i] != b[i])
+					return (int32_t)a[i] - (int32_t)b[i];
+			}
+			return 0;
+		}
+
+		uint32_t _perform_memcmp(const operation &o) {
+			auto s = dma._dmi_ptr(o.src, o.len);
+			auto d = dma._dmi_ptr(o.dst, o.len);
+			if (s && d) {
+				_dmi_access(tlm::TLM_READ_COMMAND, o.src, o.len);
+				_dmi_access(tlm::TLM_READ_COMMAND, o.dst, o.len);
+				return (uint32_t)_compare(s, d, o.len);
+			}
+
+			uint32_t off = 0;
+			while (off < o.len) {
+				auto k = std::min<uint32_t>(o.len - off, buffer.size());
+				do_transaction(tlm::TLM_READ_COMMAND, o.src + off, &buffer[0], k);
+				do_transaction(tlm::TLM_READ_COMMAND, o.dst + off, &cmp_buffer[0], k);
+				auto r = _compare(&buffer[0], &cmp_buffer[0], k);
+				if (r != 0)
+					return (uint32_t)r;
+				off += k;
+			}
+			return 0;
+		}
+
+		uint32_t _perform_memchr(const operation &o) {
+			auto value = (uint8_t)o.dst;
+
+			auto s = dma._dmi_ptr(o.src, o.len);
+			if (s) {
+				_dmi_access(tlm::TLM_READ_COMMAND, o.src, o.len);
+				auto p = (const uint8_t *)memchr(s, value, o.len);
+				return p ? o.src + (p - s) : o.src + o.len;
+			}
+
+			uint32_t off = 0;
+			while (off < o.len) {
+				auto k = std::min<uint32_t>(o.len - off, buffer.size());
+				do_transaction(tlm::TLM_READ_COMMAND, o.src + off, &buffer[0], k);
+				auto p = (const uint8_t *)memchr(&buffer[0], value, k);
+				if (p)
+					return o.src + off + (p - &buffer[0]);
+				off += k;
+			}
+			return o.src + o.len;
+		}
+
+		// memory side of a stream, directly if possible
+		void _stream_mem(tlm::tlm_command cmd, uint32_t addr, uint8_t *data, uint32_t n) {
+			auto p = dma._dmi_ptr(addr, n);
+			if (!p) {
+				_stream_periph(cmd, addr, data, n);
+				return;
+			}
+			_dmi_access(cmd, addr, n);
+			if (cmd == tlm::TLM_READ_COMMAND)
+				memcpy(data, p, n);
+			else
+				memcpy(p, data, n);
+		}
+
+		void _stream_periph(tlm::tlm_command cmd, uint32_t addr, uint8_t *data, uint32_t n) {
+			for (uint32_t off = 0; off < n; off += buffer.size()) {
+				auto k = std::min<uint32_t>(n - off, buffer.size());
+				do_transaction(cmd, addr + off, data + off, k);
+			}
+		}
 
-	void run() {
-		while (true) {
-			sc_core::wait(run_event);
+		void _perform_stream(const operation &o) {
+			auto flow = dma._flow(o.stream_in);
+			if (!flow || o.stream_item == 0 || o.len % o.stream_item != 0) {
+				error = true;
+				return;
+			}
+
+			std::vector<uint8_t> item(o.stream_item);
+			uint32_t count = o.len / o.stream_item;
+			uint32_t issued = 0;
+			uint32_t done = 0;
+			while (done < count) {
+				bool progress = false;
+				if (issued < count && flow->in_free() > 0) {
+					_stream_mem(tlm::TLM_READ_COMMAND, o.src + issued * o.stream_item, &item[0], o.stream_item);
+					_stream_periph(tlm::TLM_WRITE_COMMAND, o.stream_in, &item[0], o.stream_item);
+					issued++;
+					progress = true;
+				}
+				if (done < issued && flow->out_available() > 0) {
+					_stream_periph(tlm::TLM_READ_COMMAND, o.stream_out, &item[0], o.stream_item);
+					_stream_mem(tlm::TLM_WRITE_COMMAND, o.dst + done * o.stream_item, &item[0], o.stream_item);
+					done++;
+					progress = true;
+				}
+				if (!progress)
+					sc_core::wait(flow->in_space_event() | flow->out_data_event());
+			}
+		}
+
+		// The requester comes from HART or a descriptor, both written by
+		// software. A hart without an interrupt line is an error and gets
+		// no interrupt.
+		void _interrupt(uint32_t hart) {
+			if (hart < dma.irq_lines)
+				dma._interrupt(hart);
+			else
+				error = true;
+		}
+
+		// descriptors run from a local copy, the register bank belongs to
+		// the OP_ADDR operations of the harts. A descriptor that cannot be
+		// read ends the chain with an error and interrupts the hart that
+		// queued it.
+		void _perform_chain(const chain &c) {
+			uint32_t next = c.head;
+
+			while (next != 0) {
+				descriptor d{};
+				if (!do_transaction(tlm::TLM_READ_COMMAND, next, (uint8_t *)&d, sizeof(d))) {
+					_interrupt(c.hart);
+					return;
+				}
+
+				operation o{d.src, d.dst, d.len, d.op, 0, 0, 0};
+				if (o.op == OP_STREAM) {
+					stream_tail t{};
+					if (!do_transaction(tlm::TLM_READ_COMMAND, next + sizeof(d), (uint8_t *)&t, sizeof(t))) {
+						_interrupt(c.hart);
+						return;
+					}
+					o.stream_in = t.in;
+					o.stream_out = t.out;
+					o.stream_item = t.item;
+				}
+				_execute(o);
+
+				next = d.next;
+				if ((d.flags & DESC_IRQ) || (next == 0))
+					_interrupt((d.flags & DESC_HART_MASK) >> DESC_HART_SHIFT);
+			}
+		}
 
-			switch (op) {
+		// returns the STAT value of the operation
+		uint32_t _execute(const operation &o) {
+			if (o.op != OP_NOP) {
+				dma.perf.op();
+				dma.perf.moved(o.len);
+			}
+			switch (o.op) {
 				case OP_NOP:
 					break;
 
 				case OP_MEMCPY:
-					_perform_memcpy();
+					_perform_memcpy(o);
 					break;
 
 				case OP_MEMSET:
-					assert(false && "not implemented");
+					_perform_memset(o);
 					break;
 
 				case OP_MEMCMP:
-					assert(false && "not implemented");
-					break;
+					return _perform_memcmp(o);
 
 				case OP_MEMCHR:
-					assert(false && "not implemented");
-					break;
+					return _perform_memchr(o);
 
 				case OP_MEMMOVE:
-					assert(false && "not implemented");
+					_perform_memmove(o);
+					break;
+
+				case OP_STREAM:
+					_perform_stream(o);
 					break;
 
 				default:
-					assert(false && "unknown operation requested by software");
+					error = true;  // unknown operation requested by software
+			}
+			return 0;
+		}
+
+		void run() {
+			while (true) {
+				if (!op_pending && chains.empty())
+					sc_core::wait(run_event);
+
+				dma.perf.busy_begin();
+				error = false;
+				if (op_pending) {
+					op_pending = false;
+					operation o{src, dst, len, op, stream_in, stream_out, stream_item};
+					stat = _execute(o);
+					_interrupt(op_hart);
+				}
+
+				while (!chains.empty()) {
+					chain c = chains.front();
+					chains.pop_front();
+					_perform_chain(c);
+				}
+				dma.perf.busy_end();
+
+				if (error)
+					status |= STATUS_ERROR;
+				if (!op_pending && chains.empty())
+					status = (status & ~STATUS_BUSY) | STATUS_DONE;
 			}
+		}
+
+		void access(tlm::tlm_command cmd, uint64_t addr, uint8_t *ptr) {
+			auto it = addr_to_reg.find(addr);
+			assert(it != addr_to_reg.end());  // access to non-mapped address
+
+			// actual read/write, STATUS only takes the ERROR clear bit
+			if (cmd == tlm::TLM_READ_COMMAND) {
+				*((uint32_t *)ptr) = *it->second;
+			} else if (cmd == tlm::TLM_WRITE_COMMAND && addr == STATUS_ADDR) {
+				if (*((uint32_t *)ptr) & STATUS_ERROR)
+					status &= ~STATUS_ERROR;
+			} else if (cmd == tlm::TLM_WRITE_COMMAND) {
+				*it->second = *((uint32_t *)ptr);
+			} else {
+				assert(false && "unsupported tlm command for dma access");
+			}
+
+			// post read/write actions
+			if ((cmd == tlm::TLM_WRITE_COMMAND) && (addr == OP_ADDR)) {
+				op_pending = true;
+				op_hart = hart;
+				status = (status & ~STATUS_DONE) | STATUS_BUSY;
+				run_event.notify(dma.start_delay);
+			}
+			if ((cmd == tlm::TLM_WRITE_COMMAND) && (addr == DESC_ADDR) && (desc != 0)) {
+				chains.push_back({desc, hart});
+				status = (status & ~STATUS_DONE) | STATUS_BUSY;
+				run_event.notify(dma.start_delay);
+			}
+		}
+	};
+
+	std::vector<std::unique_ptr<Channel>> channels;
+
+	SimpleDMA(sc_core::sc_module_name, uint32_t irq_number, uint32_t burst_size = 4, unsigned num_channels = 1)
+	    : irq_number(irq_number), port_waiting(num_channels, false) {
+		assert(burst_size > 0);
+		assert(num_channels > 0 && num_channels <= MAX_CHANNELS);
+
+		tsock.register_b_transport(this, &SimpleDMA::transport);
+
+		for (unsigned i = 0; i < num_channels; ++i) {
+			std::string name = "channel" + std::to_string(i);
+			channels.emplace_back(new Channel(name.c_str(), *this, i, burst_size));
+		}
+	}
+
+	uint8_t *_dmi_ptr(uint32_t addr, uint32_t n) {
+		for (auto &r : dmi_ranges) {
+			if (r.contains(addr) && ((n == 0) || r.contains(addr + n - 1)))
+				return r.get_mem_ptr_to_global_addr<uint8_t>(addr);
+		}
+		return nullptr;
+	}
 
-			plic->gateway_trigger_interrupt(irq_number);
+	void add_flow(uint64_t start, uint64_t end, dma_flow_if *flow) {
+		flows.push_back({start, end, flow});
+	}
+
+	dma_flow_if *_flow(uint64_t addr) {
+		for (auto &f : flows) {
+			if (addr >= f.start && addr <= f.end)
+				return f.flow;
 		}
+		return nullptr;
+	}
+
+	void _interrupt(uint32_t requester) {
+		assert(requester < irq_lines);
+		plic->gateway_trigger_interrupt(irq_number + requester);
 	}
 
 	void transport(tlm::tlm_generic_payload &trans, sc_core::sc_time &delay) {
@@ -122,39 +618,118 @@ struct SimpleDMA : public sc_core::sc_module {
 
 		assert(len == 4);  // NOTE: only allow to read/write whole register
 
-		auto it = addr_to_reg.find(addr);
-		assert(it != addr_to_reg.end());  // access to non-mapped address
+		if (addr >= PERF_ADDR && addr < PERF_ADDR + PERF_BLOCK_SIZE) {
+			if (cmd == tlm::TLM_READ_COMMAND)
+				*((uint32_t *)ptr) = perf.read(addr - PERF_ADDR);
+			else if (cmd == tlm::TLM_WRITE_COMMAND)
+				perf.write(addr - PERF_ADDR, *((uint32_t *)ptr));
+			return;
+		}
 
-		// actual read/write
-		if (cmd == tlm::TLM_READ_COMMAND) {
-			*((uint32_t *)ptr) = *it->second;
-		} else if (cmd == tlm::TLM_WRITE_COMMAND) {
-			*it->second = *((uint32_t *)ptr);
-		} else {
-			assert(false && "unsupported tlm command for dma access");
+		if (addr == CHANNELS_ADDR) {
+			assert(cmd == tlm::TLM_READ_COMMAND);
+			*((uint32_t *)ptr) = channels.size();
+			return;
 		}
 
-		// post read/write actions
-		if ((cmd == tlm::TLM_WRITE_COMMAND) && (addr == OP_ADDR)) {
-			run_event.notify(sc_core::sc_time(10, sc_core::SC_NS));
+		if (addr >= CHANNEL_BASE_ADDR) {
+			auto c = (addr - CHANNEL_BASE_ADDR) / CHANNEL_STRIDE;
+			assert(c < channels.size());  // access to non-mapped address
+			channels[c]->access(cmd, (addr - CHANNEL_BASE_ADDR) % CHANNEL_STRIDE, ptr);
+		} else {
+			channels[0]->access(cmd, addr, ptr);
 		}
 
 		(void)delay;  // zero delay
 	}
 
-	void do_transaction(tlm::tlm_command cmd, uint64_t addr, uint8_t *data, unsigned num_bytes) {
-		sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+	void set_timing(unsigned beat_width, sc_core::sc_time beat_delay, sc_core::sc_time burst_delay) {
+		assert(beat_width > 0);
+		this->beat_width = beat_width;
+		this->beat_delay = beat_delay;
+		this->burst_delay = burst_delay;
+	}
+
+	sc_core::sc_time burst_time(unsigned num_bytes) {
+		unsigned beats = (num_bytes + beat_width - 1) / beat_width;
+		return burst_delay + beat_delay * beats;
+	}
+
+	// the channel owns isock until release_port
+	void acquire_port(unsigned channel) {
+		port_waiting[channel] = true;
+		while (port_busy || next_grant() != channel)
+			sc_core::wait(port_event);
+		port_waiting[channel] = false;
+		port_busy = true;
+		last_grant = channel;
+	}
+
+	void release_port() {
+		port_busy = false;
+		port_event.notify();
+	}
 
+	// direct memory work keeps the port for the time its bursts would take
+	// and, like the connector, waits for a hart holding the bus lock
+	void dmi_access(unsigned channel, const sc_core::sc_time &t) {
+		if (t != sc_core::SC_ZERO_TIME) {
+			acquire_port(channel);
+			sc_core::wait(t);
+			release_port();
+		}
+		if (bus_lock)
+			bus_lock->wait_until_unlocked();
+	}
+
+	void record_dmi(tlm::tlm_command cmd, uint64_t addr, unsigned num_bytes, const sc_core::sc_time &delay) {
+		if (!profile)
+			return;
+		tlm::tlm_generic_payload trans;
+		trans.set_command(cmd);
+		trans.set_address(addr);
+		trans.set_data_length(num_bytes);
+		profile->record(profile_initiator, profile->target_of(addr), trans, delay);
+	}
+
+	// One burst of the channel, false on an explicit error response. The
+	// channel owns the port for the burst time only, the target's own
+	// blocking wait and annotated delay pass without it.
+	bool do_transaction(unsigned channel, tlm::tlm_command cmd, uint64_t addr, uint8_t *data, unsigned num_bytes) {
 		tlm::tlm_generic_payload trans;
 		trans.set_command(cmd);
 		trans.set_address(addr);
 		trans.set_data_ptr(data);
 		trans.set_data_length(num_bytes);
 
-		isock->b_transport(trans, delay);
+		acquire_port(channel);
+		sc_core::wait(burst_time(num_bytes));
+		release_port();
 
+		sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+		isock->b_transport(trans, delay);
 		if (delay != sc_core::SC_ZERO_TIME)
 			sc_core::wait(delay);
+
+		// not every target sets OK
+		return trans.get_response_status() >= tlm::TLM_INCOMPLETE_RESPONSE;
+	}
+
+   private:
+	std::vector<bool> port_waiting;
+	bool port_busy = false;
+	unsigned last_grant = 0;
+	sc_core::sc_event port_event;
+
+	// waiting channel to grant the port to, channels.size() if none
+	unsigned next_grant() const {
+		unsigned n = channels.size();
+		for (unsigned i = 1; i <= n; ++i) {
+			unsigned c = (arbitration == ARB_PRIORITY) ? i - 1 : (last_grant + i) % n;
+			if (port_waiting[c])
+				return c;
+		}
+		return n;
 	}
 };
 
@@ -0,0 +1,18 @@
+#ifndef RISCV_VP_DMA_FLOW_H
+#define RISCV_VP_DMA_FLOW_H
+
+#include <systemc>
+
+// Request lines of a FIFO peripheral towards the DMA, used to pace
+// SimpleDMA::OP_STREAM: how many items the peripheral can accept and has
+// ready, and the events that change either count.
+struct dma_flow_if {
+	virtual ~dma_flow_if() {}
+
+	virtual unsigned in_free() = 0;
+	virtual unsigned out_available() = 0;
+	virtual const sc_core::sc_event &in_space_event() = 0;
+	virtual const sc_core::sc_event &out_data_event() = 0;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef RISCV_VP_DYNAMIC_BUS_H
+#define RISCV_VP_DYNAMIC_BUS_H
+
+#include <systemc>
+
+#include <tlm_utils/multi_passthrough_initiator_socket.h>
+#include <tlm_utils/multi_passthrough_target_socket.h>
+
+#include "bus.h"
+
+#include <cassert>
+#include <map>
+#include <vector>
+
+// SimpleBus with the number of initiators and targets fixed at elaboration
+// instead of compile time. Initiators bind to tsock in any order, targets
+// bind to isock in the order of ports. Addresses are translated to the
+// target local address space, like SimpleBus does. Approximately-timed
+// transactions are routed as well, the backward path goes to the
+// initiator that started the transaction.
+struct DynamicBus : sc_core::sc_module {
+	tlm_utils::multi_passthrough_target_socket<DynamicBus> tsock;
+	tlm_utils::multi_passthrough_initiator_socket<DynamicBus> isock;
+	std::vector<PortMapping *> ports;
+	// added to the delay of every transaction
+	sc_core::sc_time latency = sc_core::SC_ZERO_TIME;
+
+	DynamicBus(sc_core::sc_module_name) : tsock("tsock"), isock("isock") {
+		tsock.register_b_transport(this, &DynamicBus::transport);
+		tsock.register_transport_dbg(this, &DynamicBus::transport_dbg);
+		tsock.register_nb_transport_fw(this, &DynamicBus::nb_transport_fw);
+		isock.register_nb_transport_bw(this, &DynamicBus::nb_transport_bw);
+	}
+
+	// maps [start, end] to the next target bound to isock
+	template <typename TARGET_SOCKET>
+	void add_target(uint64_t start, uint64_t end, TARGET_SOCKET &target) {
+		ports.push_back(new PortMapping(start, end));
+		isock.bind(target);
+	}
+
+	int decode(uint64_t addr) {
+		for (unsigned i = 0; i < ports.size(); ++i) {
+			if (ports[i]->contains(addr))
+				return i;
+		}
+		return -1;
+	}
+
+	void transport(int, tlm::tlm_generic_payload &trans, sc_core::sc_time &delay) {
+		auto addr = trans.get_address();
+		auto id = decode(addr);
+
+		if (id < 0) {
+			trans.set_response_status(tlm::TLM_ADDRESS_ERROR_RESPONSE);
+			return;
+		}
+
+		trans.set_address(ports[id]->global_to_local(addr));
+		delay += latency;
+		isock[id]->b_transport(trans, delay);
+	}
+
+	tlm::tlm_sync_enum nb_transport_fw(int initiator, tlm::tlm_generic_payload &trans, tlm::tlm_phase &phase,
+	                                   sc_core::sc_time &delay) {
+		int id;
+		if (phase == tlm::BEGIN_REQ) {
+			auto addr = trans.get_address();
+			id = decode(addr);
+
+			if (id < 0) {
+				trans.set_response_status(tlm::TLM_ADDRESS_ERROR_RESPONSE);
+				return tlm::TLM_COMPLETED;
+			}
+
+			trans.set_address(ports[id]->global_to_local(addr));
+			routes[&trans] = route{initiator, id};
+			delay += latency;
+		} else {
+			auto it = routes.find(&trans);
+			assert(it != routes.end());
+			id = it->second.target;
+		}
+
+		auto status = isock[id]->nb_transport_fw(trans, phase, delay);
+		if (status == tlm::TLM_COMPLETED || phase == tlm::END_RESP)
+			routes.erase(&trans);
+		return status;
+	}
+
+	tlm::tlm_sync_enum nb_transport_bw(int, tlm::tlm_generic_payload &trans, tlm::tlm_phase &phase,
+	                                   sc_core::sc_time &delay) {
+		auto it = routes.find(&trans);
+		assert(it != routes.end());
+
+		auto status = tsock[it->second.initiator]->nb_transport_bw(trans, phase, delay);
+		if (status == tlm::TLM_COMPLETED || phase == tlm::END_RESP)
+			routes.erase(it);
+		return status;
+	}
+
+	unsigned transport_dbg(int, tlm::tlm_generic_payload &trans) {
+		auto addr = trans.get_address();
+		auto id = decode(addr);
+
+		if (id < 0) {
+			trans.set_response_status(tlm::TLM_ADDRESS_ERROR_RESPONSE);
+			return 0;
+		}
+
+		trans.set_address(ports[id]->global_to_local(addr));
+		return isock[id]->transport_dbg(trans);
+	}
+
+   private:
+	struct route {
+		int initiator;
+		int target;
+	};
+
+	// approximately-timed transactions between BEGIN_REQ and their end
+	std::map<tlm::tlm_generic_payload *, route> routes;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef FIXED_INT_H
+#define FIXED_INT_H
+
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+
+// Two's complement fixed-point number with W bits, I of them integer bits,
+// stored in a plain int32_t. Reproduces sc_dt::sc_fixed<W, I> with its
+// default SC_TRN quantization (round towards minus infinity) and SC_WRAP
+// overflow bit for bit, but all arithmetic is native integer adds, shifts
+// and multiplies instead of arbitrary precision sc_fxval temporaries.
+template <int W, int I>
+class fixed_int {
+    static_assert(W > 0 && W <= 32, "fixed_int supports up to 32 bit words");
+
+    public:
+        static constexpr int F = W - I;  // fractional bits
+
+        fixed_int() : v(0) {}
+        fixed_int(double d) : v(from_double(d)) {}
+
+        template <int W2, int I2>
+        fixed_int(const fixed_int<W2, I2> &o) : v(wrap(align(o.raw(), fixed_int<W2, I2>::F))) {}
+
+        static fixed_int from_raw(int64_t raw) {
+            fixed_int r;
+            r.v = wrap(raw);
+            return r;
+        }
+
+        int32_t raw() const { return v; }
+
+        double to_double() const { return std::ldexp((double)v, -F); }
+        float to_float() const { return (float)to_double(); }
+        explicit operator double() const { return to_double(); }
+        explicit operator float() const { return to_float(); }
+
+        fixed_int operator-() const { return from_raw(-(int64_t)v); }
+        fixed_int operator>>(int s) const { return from_raw(v >> s); }
+        fixed_int operator<<(int s) const { return from_raw((int64_t)v << s); }
+
+        friend fixed_int operator+(const fixed_int &a, const fixed_int &b) { return from_raw((int64_t)a.v + b.v); }
+        friend fixed_int operator-(const fixed_int &a, const fixed_int &b) { return from_raw((int64_t)a.v - b.v); }
+        friend fixed_int operator*(const fixed_int &a, const fixed_int &b) {
+            return from_raw(floor_shift((int64_t)a.v * b.v, F));
+        }
+        // product with another format, quantized to the left operand's
+        template <int W2, int I2>
+        friend fixed_int operator*(const fixed_int &a, const fixed_int<W2, I2> &b) {
+            return from_raw(floor_shift((int64_t)a.v * b.raw(), fixed_int<W2, I2>::F));
+        }
+
+        // mixed arithmetic with a scalar: the exact result is quantized, as
+        // sc_fixed does when assigning the sc_fxval temporary
+        template <typename T>
+        friend fixed_int operator+(const fixed_int &a, T b) { return from_raw((int64_t)a.v + floor_raw(b)); }
+        template <typename T>
+        friend fixed_int operator-(const fixed_int &a, T b) { return from_raw((int64_t)a.v - ceil_raw(b)); }
+
+        friend bool operator==(const fixed_int &a, const fixed_int &b) { return a.v == b.v; }
+        friend bool operator!=(const fixed_int &a, const fixed_int &b) { return a.v != b.v; }
+        friend bool operator<(const fixed_int &a, const fixed_int &b) { return a.v < b.v; }
+        friend bool operator>(const fixed_int &a, const fixed_int &b) { return a.v > b.v; }
+        friend bool operator<=(const fixed_int &a, const fixed_int &b) { return a.v <= b.v; }
+        friend bool operator>=(const fixed_int &a, const fixed_int &b) { return a.v >= b.v; }
+
+        template <typename T>
+        friend bool operator>(const fixed_int &a, T b) { return (double)a.v > scaled(b); }
+        template <typename T>
+        friend bool operator<(const fixed_int &a, T b) { return (double)a.v < scaled(b); }
+        template <typename T>
+        friend bool operator>=(const fixed_int &a, T b) { return (double)a.v >= scaled(b); }
+        template <typename T>
+        friend bool operator<=(const fixed_int &a, T b) { return (double)a.v <= scaled(b); }
+
+        friend std::ostream &operator<<(std::ostream &os, const fixed_int &a) { return os << a.to_double(); }
+
+    private:
+        int32_t v;  // sign extended to 32 bit
+
+        static int32_t wrap(int64_t raw) {
+            return (int32_t)((uint32_t)raw << (32 - W)) >> (32 - W);
+        }
+
+        static int64_t floor_shift(int64_t raw, int s) {
+            return s >= 0 ? (raw >> s) : (raw << -s);
+        }
+
+        static int64_t align(int64_t raw, int from_f) {
+            return floor_shift(raw, from_f - F);
+        }
+
+        static double scaled(double d) { return std::ldexp(d, F); }
+
+        // floor(d * 2^F) reduced modulo 2^W, exact for every finite double
+        static int64_t floor_raw(double d) {
+            double r = std::fmod(std::floor(scaled(d)), std::ldexp(1.0, W));
+            return (int64_t)r;
+        }
+
+        static int64_t ceil_raw(double d) {
+            double r = std::fmod(std::ceil(scaled(d)), std::ldexp(1.0, W));
+            return (int64_t)r;
+        }
+
+        static int32_t from_double(double d) { return wrap(floor_raw(d)); }
+};
+
+#endif
@@ -9,16 +9,28 @@
 #include "syscall.h"
 #include "platform/common/options.h"
 #include "PE.h"
+#include "bus_profile.h"
+#include "config_rom.h"
+#include "cordic_check.h"
 #include "dma.h"
+#include "dynamic_bus.h"
 #include "fe310_plic.h"
+#include "pe_pool.h"
+#include "timing_profile.h"
 
 #include "gdb-mc/gdb_server.h"
 #include "gdb-mc/gdb_runner.h"
 
 #include <boost/io/ios_state.hpp>
 #include <boost/program_options.hpp>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace rv32;
 namespace po = boost::program_options;
@@ -35,17 +47,52 @@ public:
 	addr_t clint_end_addr = 0x0200ffff;
 	addr_t sys_start_addr = 0x02010000;
 	addr_t sys_end_addr = 0x020103ff;
-	addr_t PE1_start_addr = 0x03000000;
-	addr_t PE1_end_addr = 0x03100000 - 1;
-	addr_t PE2_start_addr = 0x03100000;
-	addr_t PE2_end_addr = 0x03200000 - 1;
+	addr_t config_start_addr = 0x02020000;
+	addr_t config_end_addr = 0x020200ff;
+	addr_t pool_start_addr = 0x02030000;
+	addr_t pool_end_addr = 0x0203ffff;
+	// PE i is mapped at PE_start_addr + i * PE_stride, the reduced and
+	// extended precision PEs follow the last one
+	addr_t PE_start_addr = 0x03000000;
+	addr_t PE_stride = 0x00100000;
+	addr_t PE_lp_start_addr = 0x03200000;
+	addr_t PE_lp_end_addr = 0x03300000 - 1;
+	addr_t PE_hp_start_addr = 0x03300000;
+	addr_t PE_hp_end_addr = 0x03400000 - 1;
 	addr_t plic_start_addr = 0x40000000;
 	addr_t plic_end_addr = 0x41000000;
 	addr_t dma_start_addr = 0x70000000;
 	addr_t dma_end_addr = 0x70001000;
 
+	unsigned int harts = 2;
+	unsigned int pes = 2;
+	uint32_t dma_irq = 4;   // DMA completion for hart i raises dma_irq + i
+	uint32_t pe_irq = 20;  // PE i raises pe_irq + i, then PE_lp and PE_hp
+
 	bool quiet = false;
 	bool use_E_base_isa = false;
+	bool pe_pipelined = false;
+	bool pe_check_fixed = false;
+	bool pe_lt = false;
+	unsigned int pe_clock_ns = 10;
+	unsigned int pool_window = 4;
+	unsigned int dma_burst_size = 4;
+	unsigned int dma_beat_width = 4;
+	unsigned int dma_beat_ns = 0;
+	unsigned int dma_burst_ns = 0;
+	unsigned int dma_channels = 0;  // 0: one per hart
+	std::string dma_arbitration = "rr";
+	bool bus_profile = false;
+	std::string bus_profile_csv;
+	std::string bus_profile_json;
+	std::string timing_profile;
+	std::string timing_result;
+	std::string timing_sweep;
+	unsigned int sweep_jobs = 0;
+	std::string sweep_csv;
+	std::string sweep_dir = "sweep_runs";
+	std::string sweep_inputs;
+	TimingProfile timing;  // the timing options, then timing_profile
 
 	TinyOptions(void) {
 		// clang-format off
@@ -53,109 +100,253 @@ public:
 			("quiet", po::bool_switch(&quiet), "do not output register values on exit")
 			("memory-start", po::value<unsigned int>(&mem_start_addr), "set memory start address")
 			("memory-size", po::value<unsigned int>(&mem_size), "set memory size")
-			("use-E-base-isa", po::bool_switch(&use_E_base_isa), "use the E instead of the I integer base ISA");
+			("use-E-base-isa", po::bool_switch(&use_E_base_isa), "use the E instead of the I integer base ISA")
+			("harts", po::value<unsigned int>(&harts), "number of harts (1, 2, 4, 8 or 16)")
+			("pes", po::value<unsigned int>(&pes), "number of default precision PEs (1 to 32)")
+			("pe-pipelined", po::bool_switch(&pe_pipelined), "model the PE as a clocked CORDIC pipeline (one result per cycle)")
+			("pe-clock-ns", po::value<unsigned int>(&pe_clock_ns), "PE pipeline clock period in ns")
+			("pe-lt", po::bool_switch(&pe_lt), "loosely-timed PE target: annotate delays, synchronize only when a result is not ready")
+			("pool-window", po::value<unsigned int>(&pool_window), "jobs the PE pool keeps in flight per PE")
+			("pe-check-fixed", po::bool_switch(&pe_check_fixed), "compare the sc_fixed and fixed_int CORDIC backends over the full input range and exit")
+			("dma-burst-size", po::value<unsigned int>(&dma_burst_size), "DMA internal buffer size, i.e. max bytes per burst")
+			("dma-beat-width", po::value<unsigned int>(&dma_beat_width), "bytes the DMA moves per bus beat")
+			("dma-beat-ns", po::value<unsigned int>(&dma_beat_ns), "DMA delay per bus beat in ns")
+			("dma-burst-ns", po::value<unsigned int>(&dma_burst_ns), "DMA setup delay per burst in ns")
+			("dma-channels", po::value<unsigned int>(&dma_channels), "DMA channels with their own register bank and engine (1 to 16), default one per hart")
+			("dma-arbitration", po::value<std::string>(&dma_arbitration), "DMA bus port arbitration between channels: rr (round robin) or priority (lowest channel first)")
+			("bus-profile", po::bool_switch(&bus_profile), "count bus transactions per initiator/target and bus lock wait time, DMA direct memory accesses count as the bursts they stand for")
+			("bus-profile-csv", po::value<std::string>(&bus_profile_csv), "write the bus profile as CSV to this file (implies --bus-profile)")
+			("bus-profile-json", po::value<std::string>(&bus_profile_json), "write the bus profile as JSON to this file (implies --bus-profile)")
+			("timing-profile", po::value<std::string>(&timing_profile), "load PE, DMA and bus timing from this file (key = value lines, see timing_profile.h), its keys override the matching options")
+			("timing-result", po::value<std::string>(&timing_result), "append the timing profile, simulated ns and instruction count of the run as a CSV line to this file")
+			("timing-sweep", po::value<std::string>(&timing_sweep), "comma separated timing profiles, run the program once per profile as parallel VP processes and gather the results")
+			("sweep-jobs", po::value<unsigned int>(&sweep_jobs), "VP processes a timing sweep runs at once, default one per host thread")
+			("sweep-csv", po::value<std::string>(&sweep_csv), "write the timing sweep results as CSV to this file")
+			("sweep-dir", po::value<std::string>(&sweep_dir), "directory of the timing sweep runs, each run works and logs in <dir>/<n>-<profile name>")
+			("sweep-inputs", po::value<std::string>(&sweep_inputs), "comma separated files the guest program reads, copied into every run directory of a timing sweep");
         	// clang-format on
         }
 
 	void parse(int argc, char **argv) override {
 		Options::parse(argc, argv);
 		mem_end_addr = mem_start_addr + mem_size - 1;
+		if (pool_window < 1) {
+			std::cerr << "Error parsing command line options: --pool-window must be at least 1" << std::endl;
+			exit(-1);
+		}
+		if (pes < 1 || pes > 32) {
+			std::cerr << "Error parsing command line options: --pes must be between 1 and 32" << std::endl;
+			exit(-1);
+		}
+		if (dma_channels == 0)
+			dma_channels = harts;
+		if (dma_channels > SimpleDMA::MAX_CHANNELS) {
+			std::cerr << "Error parsing command line options: --dma-channels must be between 1 and "
+			          << SimpleDMA::MAX_CHANNELS << std::endl;
+			exit(-1);
+		}
+		if (dma_arbitration != "rr" && dma_arbitration != "priority") {
+			std::cerr << "Error parsing command line options: --dma-arbitration must be rr or priority" << std::endl;
+			exit(-1);
+		}
+		PE_lp_start_addr = PE_start_addr + pes * PE_stride;
+		PE_lp_end_addr = PE_lp_start_addr + PE_stride - 1;
+		PE_hp_start_addr = PE_lp_start_addr + PE_stride;
+		PE_hp_end_addr = PE_hp_start_addr + PE_stride - 1;
+		bus_profile = bus_profile || !bus_profile_csv.empty() || !bus_profile_json.empty();
+
+		timing.pe_clock_ns = pe_clock_ns;
+		timing.dma_beat_width = dma_beat_width;
+		timing.dma_beat_ns = dma_beat_ns;
+		timing.dma_burst_ns = dma_burst_ns;
+		if (!timing_profile.empty()) {
+			try {
+				timing.load(timing_profile);
+			} catch (std::runtime_error &e) {
+				std::cerr << "Error parsing command line options: " << e.what() << std::endl;
+				exit(-1);
+			}
+		}
 	}
 };
 
-int sc_main(int argc, char **argv) {
-	TinyOptions opt;
-	opt.parse(argc, argv);
-
-	std::srand(std::time(nullptr));  // use current time as seed for random generator
-
-	tlm::tlm_global_quantum::instance().set(sc_core::sc_time(opt.tlm_global_quantum, sc_core::SC_NS));
-
-	ISS core0(0);
-	ISS core1(1);
-	CombinedMemoryInterface core0_mem_if("MemoryInterface0", core0);
-	CombinedMemoryInterface core1_mem_if("MemoryInterface1", core1);
+// Builds and runs the platform with NH harts; the CLINT and PLIC take the
+// hart count as a template parameter.
+template <unsigned NH>
+int run_platform(TinyOptions &opt) {
+	std::vector<std::unique_ptr<ISS>> cores;
+	std::vector<std::unique_ptr<CombinedMemoryInterface>> core_mem_ifs;
+	for (unsigned i = 0; i < NH; ++i) {
+		cores.emplace_back(new ISS(i));
+		std::string name = "MemoryInterface" + std::to_string(i);
+		core_mem_ifs.emplace_back(new CombinedMemoryInterface(name.c_str(), *cores[i]));
+	}
 
 	SimpleMemory mem("SimpleMemory", opt.mem_size);
 	ELFLoader loader(opt.input_program.c_str());
-	SimpleBus<4, 7> bus("SimpleBus");
+	DynamicBus bus("SimpleBus");
 	SyscallHandler sys("SyscallHandler");
-	CLINT<2> clint("CLINT");
+	CLINT<NH> clint("CLINT");
 	DebugMemoryInterface dbg_if("DebugMemoryInterface");
-	SimpleDMA dma("SimpleDMA", 4);
-	PE pe1("pe1");
-	PE pe2("pe2");
-	FE310_PLIC<2, 64, 96, 32> plic("PLIC");
+	SimpleDMA dma("SimpleDMA", opt.dma_irq, opt.dma_burst_size, opt.dma_channels);
+	ConfigROM config("ConfigROM");
+	sc_core::sc_time pe_clock = TimingProfile::ns(opt.timing.pe_clock_ns);
+	std::vector<std::unique_ptr<PE>> pes;
+	for (unsigned i = 0; i < opt.pes; ++i) {
+		std::string name = "pe" + std::to_string(i + 1);
+		pes.emplace_back(new PE(name.c_str(), opt.pe_pipelined, pe_clock, opt.pe_lt));
+	}
+	PE_lp pe_lp("pe_lp", opt.pe_pipelined, pe_clock, opt.pe_lt);
+	PE_hp pe_hp("pe_hp", opt.pe_pipelined, pe_clock, opt.pe_lt);
+	FE310_PLIC<NH, 64, 96, 32> plic("PLIC");
+	// the pool dispatches to the default precision PEs, one port per hart
+	std::vector<uint64_t> pe_addrs;
+	for (unsigned i = 0; i < opt.pes; ++i)
+		pe_addrs.push_back(opt.PE_start_addr + i * opt.PE_stride);
+	PEPool pool("PEPool", pe_addrs, NH, opt.pool_window);
 
-	std::shared_ptr<BusLock> bus_lock = std::make_shared<BusLock>();
-	core0_mem_if.bus_lock = bus_lock;
-	core1_mem_if.bus_lock = bus_lock;
+	config.set(ConfigROM::HARTS_ADDR, NH);
+	config.set(ConfigROM::PES_ADDR, opt.pes);
+	config.set(ConfigROM::PE_BASE_ADDR, opt.PE_start_addr);
+	config.set(ConfigROM::PE_STRIDE_ADDR, opt.PE_stride);
+	config.set(ConfigROM::PE_IRQ_ADDR, opt.pe_irq);
+	config.set(ConfigROM::PE_LP_BASE_ADDR, opt.PE_lp_start_addr);
+	config.set(ConfigROM::PE_HP_BASE_ADDR, opt.PE_hp_start_addr);
+	config.set(ConfigROM::DMA_BASE_ADDR, opt.dma_start_addr);
+	config.set(ConfigROM::DMA_IRQ_ADDR, opt.dma_irq);
+	config.set(ConfigROM::DMA_CHANNELS_ADDR, opt.dma_channels);
+	config.set(ConfigROM::POOL_BASE_ADDR, opt.pool_start_addr);
+	config.set(ConfigROM::POOL_PORTS_ADDR, NH);
+
+	// targets in address order
+	bus.add_target(opt.mem_start_addr, opt.mem_end_addr, mem.tsock);
+	bus.add_target(opt.clint_start_addr, opt.clint_end_addr, clint.tsock);
+	bus.add_target(opt.sys_start_addr, opt.sys_end_addr, sys.tsock);
+	bus.add_target(opt.config_start_addr, opt.config_end_addr, config.tsock);
+	bus.add_target(opt.pool_start_addr, opt.pool_end_addr, pool.tsock);
+	for (unsigned i = 0; i < opt.pes; ++i) {
+		TinyOptions::addr_t start = opt.PE_start_addr + i * opt.PE_stride;
+		bus.add_target(start, start + opt.PE_stride - 1, pes[i]->tsock);
+		dma.add_flow(start, start + opt.PE_stride - 1, pes[i].get());
+	}
+	bus.add_target(opt.PE_lp_start_addr, opt.PE_lp_end_addr, pe_lp.tsock);
+	dma.add_flow(opt.PE_lp_start_addr, opt.PE_lp_end_addr, &pe_lp);
+	bus.add_target(opt.PE_hp_start_addr, opt.PE_hp_end_addr, pe_hp.tsock);
+	dma.add_flow(opt.PE_hp_start_addr, opt.PE_hp_end_addr, &pe_hp);
+	bus.add_target(opt.plic_start_addr, opt.plic_end_addr, plic.tsock);
+	bus.add_target(opt.dma_start_addr, opt.dma_end_addr, dma.tsock);
 
-	bus.ports[0] = new PortMapping(opt.mem_start_addr, opt.mem_end_addr);
-	bus.ports[1] = new PortMapping(opt.clint_start_addr, opt.clint_end_addr);
-	bus.ports[2] = new PortMapping(opt.sys_start_addr, opt.sys_end_addr);
-	bus.ports[3] = new PortMapping(opt.PE1_start_addr, opt.PE1_end_addr);
-	bus.ports[4] = new PortMapping(opt.PE2_start_addr, opt.PE2_end_addr);
-	bus.ports[5] = new PortMapping(opt.dma_start_addr, opt.dma_end_addr);
-	bus.ports[6] = new PortMapping(opt.plic_start_addr, opt.plic_end_addr);
+	// probes are only instantiated when profiling, the default platform
+	// binds the initiators directly to the bus
+	BusProfile *profile = nullptr;
+	if (opt.bus_profile) {
+		std::vector<std::string> initiators;
+		for (unsigned i = 0; i < NH; ++i)
+			initiators.push_back("core" + std::to_string(i));
+		initiators.push_back("dma");
+		initiators.push_back("pool");
+		std::vector<std::pair<std::string, PortMapping *>> targets;
+		for (unsigned t = 0; t < bus.ports.size(); ++t) {
+			targets.emplace_back("", bus.ports[t]);
+		}
+		const char *fixed_names[] = {"mem", "clint", "syscall", "config", "pool"};
+		for (unsigned t = 0; t < 5; ++t)
+			targets[t].first = fixed_names[t];
+		for (unsigned i = 0; i < opt.pes; ++i)
+			targets[5 + i].first = pes[i]->name();
+		targets[5 + opt.pes].first = "pe_lp";
+		targets[6 + opt.pes].first = "pe_hp";
+		targets[7 + opt.pes].first = "plic";
+		targets[8 + opt.pes].first = "dma";
+		profile = new BusProfile(initiators, targets);
+	}
+
+	std::shared_ptr<BusLock> bus_lock = std::make_shared<BusLock>();
+	for (unsigned i = 0; i < NH; ++i)
+		core_mem_ifs[i]->bus_lock = profiled_lock(profile, i, bus_lock);
 
 	loader.load_executable_image(mem, mem.size, opt.mem_start_addr);
 
-	core0.init(&core0_mem_if, &core0_mem_if, &clint, loader.get_entrypoint(),
-	           opt.mem_end_addr - 3);  // -3 to not overlap with the next region and stay 32 bit aligned
-	core1.init(&core1_mem_if, &core1_mem_if, &clint, loader.get_entrypoint(), opt.mem_end_addr - 32767);
+	// every hart starts with its own 32 KB stack below the end of memory
+	for (unsigned i = 0; i < NH; ++i) {
+		cores[i]->init(core_mem_ifs[i].get(), core_mem_ifs[i].get(), &clint, loader.get_entrypoint(),
+		               opt.mem_end_addr - (i == 0 ? 3 : 32768 * i - 1));
+	}
 
 	sys.init(mem.data, opt.mem_start_addr, loader.get_heap_addr());
-	sys.register_core(&core0);
-	sys.register_core(&core1);
+	for (auto &core : cores)
+		sys.register_core(core.get());
 
-	if (opt.intercept_syscalls) {
-		core0.sys = &sys;
-		core1.sys = &sys;
+	for (auto &core : cores) {
+		if (opt.intercept_syscalls)
+			core->sys = &sys;
+		core->error_on_zero_traphandler = opt.error_on_zero_traphandler;
 	}
-	core0.error_on_zero_traphandler = opt.error_on_zero_traphandler;
-	core1.error_on_zero_traphandler = opt.error_on_zero_traphandler;
 
 	// connect TLM sockets
-	core0_mem_if.isock.bind(bus.tsocks[0]);
-	core1_mem_if.isock.bind(bus.tsocks[1]);
+	for (unsigned i = 0; i < NH; ++i)
+		bind_profiled(profile, i, core_mem_ifs[i]->isock, bus.tsock);
 
 	PeripheralWriteConnector dma_connector("SimpleDMA-Connector");  // to respect ISS bus locking
-	dma_connector.isock.bind(bus.tsocks[3]);
+	bind_profiled(profile, NH, dma_connector.isock, bus.tsock);
 	dma.isock.bind(dma_connector.tsock);
-	dma_connector.bus_lock = bus_lock;
+	dma_connector.bus_lock = profiled_lock(profile, NH, bus_lock);
+	dma.bus_lock = dma_connector.bus_lock;
+	dma.profile = profile;
+	dma.profile_initiator = NH;
+
+	// the pool only talks to the PEs, so it needs no bus locking and keeps
+	// its approximately-timed result reads
+	bind_profiled(profile, NH + 1, pool.isock, bus.tsock);
 
-	dbg_if.isock.bind(bus.tsocks[2]);
-	bus.isocks[0].bind(mem.tsock);
-	bus.isocks[1].bind(clint.tsock);
-	bus.isocks[2].bind(sys.tsock);
-	bus.isocks[3].bind(pe1.tsock);
-	bus.isocks[4].bind(pe2.tsock);
-	bus.isocks[5].bind(dma.tsock);
-	bus.isocks[6].bind(plic.tsock);
+	dbg_if.isock.bind(bus.tsock);
 
 	// connect interrupt signals/communication
-	plic.target_harts[0] = &core0;
-	plic.target_harts[1] = &core1;
-	clint.target_harts[0] = &core0;
-	clint.target_harts[1] = &core1;
+	for (unsigned i = 0; i < NH; ++i) {
+		plic.target_harts[i] = cores[i].get();
+		clint.target_harts[i] = cores[i].get();
+	}
 	dma.plic = &plic;
+	dma.irq_lines = NH;
+	for (unsigned i = 0; i < opt.pes; ++i) {
+		pes[i]->plic = &plic;
+		pes[i]->irq_number = opt.pe_irq + i;
+	}
+	pe_lp.plic = &plic;
+	pe_lp.irq_number = opt.pe_irq + opt.pes;
+	pe_hp.plic = &plic;
+	pe_hp.irq_number = opt.pe_irq + opt.pes + 1;
+	dma.dmi_ranges.emplace_back(MemoryDMI::create_start_size_mapping(mem.data, opt.mem_start_addr, mem.size));
+	dma.set_timing((unsigned)opt.timing.dma_beat_width, TimingProfile::ns(opt.timing.dma_beat_ns),
+	               TimingProfile::ns(opt.timing.dma_burst_ns));
+	dma.start_delay = TimingProfile::ns(opt.timing.dma_start_ns);
+	dma.arbitration = opt.dma_arbitration == "priority" ? SimpleDMA::ARB_PRIORITY : SimpleDMA::ARB_ROUND_ROBIN;
+	bus.latency = TimingProfile::ns(opt.timing.bus_ns);
+	sc_core::sc_time pe_input = TimingProfile::ns(opt.timing.pe_input_ns);
+	sc_core::sc_time pe_output = TimingProfile::ns(opt.timing.pe_output_ns);
+	sc_core::sc_time pe_register = TimingProfile::ns(opt.timing.pe_register_ns);
+	for (auto &pe : pes)
+		pe->set_timing(pe_input, pe_output, pe_register);
+	pe_lp.set_timing(pe_input, pe_output, pe_register);
+	pe_hp.set_timing(pe_input, pe_output, pe_register);
 
 	// switch for printing instructions
-	core0.trace = opt.trace_mode;
-	core1.trace = opt.trace_mode;
+	for (auto &core : cores)
+		core->trace = opt.trace_mode;
 
 	std::vector<debug_target_if *> threads;
-	threads.push_back(&core0);
-	threads.push_back(&core1);
+	for (auto &core : cores)
+		threads.push_back(core.get());
 
 	if (opt.use_debug_runner) {
 		auto server = new GDBServer("GDBServer", threads, &dbg_if, opt.debug_port);
-		new GDBServerRunner("GDBRunner0", server, &core0);
-		new GDBServerRunner("GDBRunner1", server, &core1);
+		for (unsigned i = 0; i < NH; ++i) {
+			std::string name = "GDBRunner" + std::to_string(i);
+			new GDBServerRunner(name.c_str(), server, cores[i].get());
+		}
 	} else {
-		new DirectCoreRunner(core0);
-		new DirectCoreRunner(core1);
+		for (auto &core : cores)
+			new DirectCoreRunner(*core);
 	}
 
 	if (opt.quiet)
@@ -163,9 +354,83 @@ int sc_main(int argc, char **argv) {
 
 	sc_core::sc_start();
 	if (!opt.quiet) {
-		core0.show();
-		core1.show();
+		for (auto &core : cores)
+			core->show();
+		for (auto &pe : pes)
+			pe->show_timing();
+		pe_lp.show_timing();
+		pe_hp.show_timing();
+		if (pool.jobs() > 0)
+			pool.show_stats();
+		if (profile)
+			profile->report(std::cout);
+	}
+	if (!opt.timing_result.empty()) {
+		uint64_t instret = 0;
+		for (auto &core : cores)
+			instret += core->csrs.instret.reg;
+		std::ofstream result(opt.timing_result, std::ios::app);
+		result << opt.timing.name << "," << sc_core::sc_time_stamp().to_seconds() * 1e9 << "," << instret << std::endl;
+	}
+	if (profile && !opt.bus_profile_csv.empty()) {
+		std::ofstream csv(opt.bus_profile_csv);
+		profile->write_csv(csv);
+	}
+	if (profile && !opt.bus_profile_json.empty()) {
+		std::ofstream json(opt.bus_profile_json);
+		profile->write_json(json);
 	}
 
 	return 0;
 }
+
+int sc_main(int argc, char **argv) {
+	TinyOptions opt;
+	opt.parse(argc, argv);
+
+	if (opt.pe_check_fixed) {
+		unsigned long mismatches = 0;
+		mismatches += cordic_backend_check<16, 8, 9, 7>(std::cout);
+		mismatches += cordic_backend_check<12, 4, 9, 5>(std::cout);
+		mismatches += cordic_backend_check<24, 8, 9, 16>(std::cout);
+		return mismatches == 0 ? 0 : 1;
+	}
+
+	if (!opt.timing_sweep.empty()) {
+		TimingSweep sweep;
+		std::stringstream list(opt.timing_sweep);
+		std::string profile;
+		while (std::getline(list, profile, ','))
+			if (!profile.empty())
+				sweep.profiles.push_back(profile);
+		sweep.jobs = opt.sweep_jobs ? opt.sweep_jobs : std::max(1u, std::thread::hardware_concurrency());
+		sweep.csv = opt.sweep_csv;
+		sweep.dir = opt.sweep_dir;
+		std::stringstream inputs(opt.sweep_inputs);
+		std::string input;
+		while (std::getline(inputs, input, ','))
+			if (!input.empty())
+				sweep.inputs.push_back(input);
+		return sweep.run(argc, argv);
+	}
+
+	std::srand(std::time(nullptr));  // use current time as seed for random generator
+
+	tlm::tlm_global_quantum::instance().set(sc_core::sc_time(opt.tlm_global_quantum, sc_core::SC_NS));
+
+	switch (opt.harts) {
+		case 1:
+			return run_platform<1>(opt);
+		case 2:
+			return run_platform<2>(opt);
+		case 4:
+			return run_platform<4>(opt);
+		case 8:
+			return run_platform<8>(opt);
+		case 16:
+			return run_platform<16>(opt);
+		default:
+			std::cerr << "unsupported number of harts: " << opt.harts << std::endl;
+			return 1;
+	}
+}
@@ -0,0 +1,409 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <systemc>
+#include <tlm_utils/simple_initiator_socket.h>
+
+#include "PE.h"
+#include "cordic_check.h"
+
+namespace po = boost::program_options;
+
+// Host-only testbench of the CORDIC PE, no ISS in the loop. It sweeps the
+// angle and magnitude range through the bus interface and compares the
+// results against std::cos/std::sin and std::hypot/std::atan2, checks the
+// DCT mode's transform against a double precision DCT-II, then measures
+// sustained jobs per simulated and per host second, once through tsock and
+// once through the operand/result fifos directly. With --check-fixed it
+// first makes sure the fixed_int backend is bit-exact with sc_fixed for
+// the precision under test.
+struct BenchOptions {
+	std::string precision = "default";
+	bool pe_pipelined = false;
+	bool pe_lt = false;
+	bool check_fixed = false;
+	unsigned int pe_clock_ns = 10;
+	unsigned int angle_steps = 720;
+	unsigned int magnitude_steps = 8;
+	unsigned int jobs = 100000;
+	double max_error_lsb = 0;
+	double max_dct_error_lsb = 0;
+
+	void parse(int argc, char **argv) {
+		po::options_description desc("PE testbench options");
+		// clang-format off
+		desc.add_options()
+			("help", "show this help")
+			("precision", po::value<std::string>(&precision), "PE under test: default (CORDIC<16, 8, 9, 7>), lp (CORDIC<12, 4, 9, 5>) or hp (CORDIC<24, 8, 9, 16>)")
+			("pe-pipelined", po::bool_switch(&pe_pipelined), "pipelined, clocked PE instead of the untimed one")
+			("pe-lt", po::bool_switch(&pe_lt), "loosely-timed PE target")
+			("pe-clock-ns", po::value<unsigned int>(&pe_clock_ns), "PE clock period in ns")
+			("check-fixed", po::bool_switch(&check_fixed), "compare the sc_fixed and fixed_int CORDIC backends over the full input range, exit with 1 on a mismatch")
+			("angle-steps", po::value<unsigned int>(&angle_steps), "angles per magnitude in the accuracy sweep")
+			("magnitude-steps", po::value<unsigned int>(&magnitude_steps), "magnitudes in the accuracy sweep, halving from full scale")
+			("jobs", po::value<unsigned int>(&jobs), "jobs per throughput run")
+			("max-error-lsb", po::value<double>(&max_error_lsb), "exit with 1 if a result is off by more LSBs than this, 0 disables the check")
+			("max-dct-error-lsb", po::value<double>(&max_dct_error_lsb), "exit with 1 if a DCT coefficient is off by more LSBs than this, 0 disables the check");
+		// clang-format on
+
+		po::variables_map vm;
+		try {
+			po::store(po::parse_command_line(argc, argv, desc), vm);
+			if (vm.count("help")) {
+				std::cout << desc << std::endl;
+				exit(0);
+			}
+			po::notify(vm);
+			if (precision != "default" && precision != "lp" && precision != "hp")
+				throw po::error("--precision must be default, lp or hp");
+			if (pe_clock_ns < 1 || angle_steps < 1 || magnitude_steps < 1 || jobs < 1)
+				throw po::error("--pe-clock-ns, --angle-steps, --magnitude-steps and --jobs must be at least 1");
+		} catch (po::error &e) {
+			std::cerr << "Error parsing command line options: " << e.what() << std::endl;
+			exit(1);
+		}
+	}
+};
+
+struct error_stats {
+	double max = 0;
+	double sum_sq = 0;
+	unsigned long n = 0;
+
+	void add(double e) {
+		e = std::fabs(e);
+		max = std::max(max, e);
+		sum_sq += e * e;
+		n++;
+	}
+
+	void add(const error_stats &o) {
+		max = std::max(max, o.max);
+		sum_sq += o.sum_sq;
+		n += o.n;
+	}
+
+	double rms() const {
+		return n ? std::sqrt(sum_sq / n) : 0.0;
+	}
+};
+
+template <int W, int DATA_I, int ANGLE_I, unsigned int ITER>
+struct PEBench : public sc_core::sc_module {
+	typedef CordicPE<W, DATA_I, ANGLE_I, ITER> pe_t;
+	typedef typename pe_t::data_t data_t;
+	typedef typename pe_t::angle_t angle_t;
+
+	struct job {
+		float abz[3];
+		bool vectoring;
+	};
+
+	tlm_utils::simple_initiator_socket<PEBench> isock;
+	pe_t &pe;
+	const BenchOptions &opt;
+	int status = 0;
+
+	std::vector<job> jobs;
+	std::vector<job> results;
+	sc_core::sc_event bus_start;
+	sc_core::sc_event fifo_start;
+	sc_core::sc_event done;
+	// jobs written by bus_feed, bus_collect never reads ahead of them: the
+	// loosely-timed PE computes on the Z write and has nothing to wait on
+	size_t submitted = 0;
+	sc_core::sc_event submitted_event;
+
+	// one LSB of the data word
+	static constexpr double LSB = 1.0 / (1 << (W - DATA_I));
+
+	SC_HAS_PROCESS(PEBench);
+
+	PEBench(sc_core::sc_module_name name, pe_t &pe, const BenchOptions &opt)
+	    : sc_module(name), isock("isock"), pe(pe), opt(opt) {
+		isock.bind(pe.tsock);
+		SC_THREAD(run);
+		SC_THREAD(bus_feed);
+		SC_THREAD(bus_collect);
+		SC_THREAD(fifo_feed);
+		SC_THREAD(fifo_collect);
+	}
+
+	void run() {
+		std::cout << "CORDIC<" << W << ", " << DATA_I << ", " << ANGLE_I << ", " << ITER << "> "
+		          << (opt.pe_pipelined ? "pipelined" : "untimed") << (opt.pe_lt ? ", loosely-timed" : "")
+		          << ", LSB " << LSB << std::endl;
+		if (opt.check_fixed && cordic_backend_check<W, DATA_I, ANGLE_I, ITER>(std::cout) > 0) {
+			std::cout << "fixed_int backend differs from sc_fixed" << std::endl;
+			status = 1;
+		}
+		accuracy();
+		dct_accuracy();
+		throughput("tsock", bus_start);
+		throughput("fifos", fifo_start);
+		sc_core::sc_stop();
+	}
+
+	// runs the current jobs through one path, its feed and collect threads
+	// overlap like a DMA writing operands and a hart reading results
+	void execute(sc_core::sc_event &start) {
+		results.assign(jobs.size(), job());
+		submitted = 0;
+		start.notify(sc_core::SC_ZERO_TIME);
+		wait(done);
+	}
+
+	void transport(tlm::tlm_command cmd, uint64_t addr, void *data, unsigned int len) {
+		sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+
+		tlm::tlm_generic_payload trans;
+		trans.set_command(cmd);
+		trans.set_address(addr);
+		trans.set_data_ptr((unsigned char *)data);
+		trans.set_data_length(len);
+		trans.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+
+		isock->b_transport(trans, delay);
+		assert(trans.is_response_ok());
+
+		if (delay != sc_core::SC_ZERO_TIME)
+			wait(delay);
+	}
+
+	void bus_feed() {
+		while (true) {
+			wait(bus_start);
+			uint32_t mode = PE_MODE_ROTATION;
+			transport(tlm::TLM_WRITE_COMMAND, PE_MODE_ADDR, &mode, 4);
+			for (auto &j : jobs) {
+				uint32_t m = j.vectoring ? PE_MODE_VECTORING : PE_MODE_ROTATION;
+				if (m != mode) {
+					mode = m;
+					transport(tlm::TLM_WRITE_COMMAND, PE_MODE_ADDR, &mode, 4);
+				}
+				transport(tlm::TLM_WRITE_COMMAND, PE_INPUT_A_ADDR, j.abz, 12);
+				submitted++;
+				submitted_event.notify();
+			}
+		}
+	}
+
+	void bus_collect() {
+		while (true) {
+			wait(bus_start);
+			for (size_t n = 0; n < results.size(); ++n) {
+				while (n >= submitted)
+					wait(submitted_event);
+				transport(tlm::TLM_READ_COMMAND, PE_OUTPUT_A_ADDR, results[n].abz, 12);
+			}
+			done.notify();
+		}
+	}
+
+	void fifo_feed() {
+		while (true) {
+			wait(fifo_start);
+			for (auto &j : jobs) {
+				pe.i_a.write(data_t(j.abz[0]));
+				pe.i_b.write(data_t(j.abz[1]));
+				pe.i_z.write(angle_t(j.abz[2]));
+				pe.i_mode.write(j.vectoring);
+			}
+		}
+	}
+
+	void fifo_collect() {
+		while (true) {
+			wait(fifo_start);
+			for (auto &r : results) {
+				r.abz[0] = (float)pe.o_a.read();
+				r.abz[1] = (float)pe.o_b.read();
+				r.abz[2] = (float)pe.o_z.read();
+			}
+			done.notify();
+		}
+	}
+
+	static double radians(double deg) {
+		return deg * M_PI / 180.0;
+	}
+
+	// difference of two angles in degrees, wrapped to [-180, 180)
+	static double angle_error(double a, double b) {
+		double d = std::fmod(a - b + 180.0, 360.0);
+		return (d < 0 ? d + 360.0 : d) - 180.0;
+	}
+
+	// Sweeps the angle over [-180, 180) degrees for magnitudes halving
+	// from the largest one the datapath holds without overflow (full scale
+	// times the gain compensation, the iterations grow the vector by its
+	// inverse), in rotation and vectoring mode. The expected
+	// values are computed from the quantized operands, so the errors are
+	// those of the datapath alone.
+	void accuracy() {
+		const double max_magnitude = 0.99 * std::ldexp(1.0, DATA_I - 1) * pe_t::datapath_t::GAIN;
+
+		std::vector<double> magnitudes;
+		for (unsigned int i = 0; i < opt.magnitude_steps; ++i) {
+			double r = std::ldexp(max_magnitude, -(int)i);
+			if (r < 4 * LSB)
+				break;
+			magnitudes.push_back(r);
+		}
+
+		jobs.clear();
+		for (double r : magnitudes) {
+			for (unsigned int k = 0; k < opt.angle_steps; ++k) {
+				double z = -180.0 + 360.0 * (k + 0.5) / opt.angle_steps;
+				jobs.push_back(job{{(float)r, 0.0f, (float)z}, false});
+				jobs.push_back(job{{(float)(r * std::cos(radians(z))), (float)(r * std::sin(radians(z))), 0.0f},
+				                   true});
+			}
+		}
+		execute(bus_start);
+
+		std::cout << "accuracy, " << opt.angle_steps << " angles per magnitude, errors in LSB (angles in degrees)"
+		          << std::endl;
+		std::cout << std::setw(12) << "magnitude" << std::setw(12) << "rot max" << std::setw(12) << "rot rms"
+		          << std::setw(12) << "|v| max" << std::setw(12) << "|v| rms" << std::setw(12) << "angle max"
+		          << std::setw(12) << "angle rms" << std::endl;
+
+		error_stats rot_all, mag_all, angle_all;
+		size_t n = 0;
+		for (double r : magnitudes) {
+			error_stats rot, mag, angle;
+			for (unsigned int k = 0; k < opt.angle_steps; ++k, n += 2) {
+				const job &in = jobs[n];
+				const job &out = results[n];
+				double qr = (double)data_t(in.abz[0]);
+				double qz = radians((double)angle_t(in.abz[2]));
+				rot.add((out.abz[0] - qr * std::cos(qz)) / LSB);
+				rot.add((out.abz[1] - qr * std::sin(qz)) / LSB);
+
+				const job &vin = jobs[n + 1];
+				const job &vout = results[n + 1];
+				double qx = (double)data_t(vin.abz[0]);
+				double qy = (double)data_t(vin.abz[1]);
+				mag.add((vout.abz[0] - std::hypot(qx, qy)) / LSB);
+				angle.add(angle_error(vout.abz[2], std::atan2(qy, qx) * 180.0 / M_PI));
+			}
+			std::cout << std::setw(12) << r << std::setw(12) << rot.max << std::setw(12) << rot.rms() << std::setw(12)
+			          << mag.max << std::setw(12) << mag.rms() << std::setw(12) << angle.max << std::setw(12)
+			          << angle.rms() << std::endl;
+			rot_all.add(rot);
+			mag_all.add(mag);
+			angle_all.add(angle);
+		}
+		std::cout << std::setw(12) << "all" << std::setw(12) << rot_all.max << std::setw(12) << rot_all.rms()
+		          << std::setw(12) << mag_all.max << std::setw(12) << mag_all.rms() << std::setw(12) << angle_all.max
+		          << std::setw(12) << angle_all.rms() << std::endl;
+
+		if (opt.max_error_lsb > 0 && std::max(rot_all.max, mag_all.max) > opt.max_error_lsb) {
+			std::cout << "error exceeds " << opt.max_error_lsb << " LSB" << std::endl;
+			status = 1;
+		}
+	}
+
+	// Row lengths that take each branch of CORDIC_dct: the Loeffler
+	// 8-point factorization, the even/odd split down to an odd length and
+	// the DCT-IV of both an even and an odd half, the direct odd length,
+	// and a long row with a block exponent.
+	static constexpr unsigned int DCT_LENGTHS[] = {8, 12, 15, 64};
+	static constexpr unsigned int DCT_ROWS = 32;
+
+	// Runs normally distributed rows through the DCT mode's transform and
+	// compares them against the orthonormal DCT-II of the quantized samples
+	// in double precision.
+	void dct_accuracy() {
+		const double range = std::ldexp(1.0, DATA_I - 1);
+		std::mt19937 rng(6470);
+		std::normal_distribution<double> sample(0.0, std::min(1.0, range / 8));
+
+		std::cout << "DCT accuracy, " << DCT_ROWS << " rows per length, errors in LSB" << std::endl;
+		std::cout << std::setw(12) << "length" << std::setw(12) << "max" << std::setw(12) << "rms" << std::endl;
+
+		error_stats all;
+		for (unsigned int m : DCT_LENGTHS) {
+			error_stats e;
+			std::vector<data_t> in(m), out(m);
+			for (unsigned int r = 0; r < DCT_ROWS; ++r) {
+				for (auto &x : in)
+					x = data_t(sample(rng));
+				pe_t::dct_t::transform(in.data(), out.data(), m, range);
+				for (unsigned int j = 0; j < m; ++j) {
+					double X = 0;
+					for (unsigned int k = 0; k < m; ++k)
+						X += (double)in[k] * std::cos(M_PI * (k + 0.5) * j / m);
+					X *= std::sqrt((j ? 2.0 : 1.0) / m);
+					e.add(((double)out[j] - X) / LSB);
+				}
+			}
+			std::cout << std::setw(12) << m << std::setw(12) << e.max << std::setw(12) << e.rms() << std::endl;
+			all.add(e);
+		}
+
+		if (opt.max_dct_error_lsb > 0 && all.max > opt.max_dct_error_lsb) {
+			std::cout << "DCT error exceeds " << opt.max_dct_error_lsb << " LSB" << std::endl;
+			status = 1;
+		}
+	}
+
+	// sustained rotation jobs over the whole angle range, from the first
+	// operand in to the last result out
+	void throughput(const char *path, sc_core::sc_event &start) {
+		jobs.clear();
+		for (unsigned int n = 0; n < opt.jobs; ++n) {
+			float z = (float)(-180.0 + 360.0 * ((n * 97) % opt.jobs + 0.5) / opt.jobs);
+			jobs.push_back(job{{1.0f, 0.0f, z}, false});
+		}
+
+		sc_core::sc_time sim_start = sc_core::sc_time_stamp();
+		auto host_start = std::chrono::steady_clock::now();
+		execute(start);
+		double sim_s = (sc_core::sc_time_stamp() - sim_start).to_seconds();
+		double host_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - host_start).count();
+
+		std::cout << "throughput through " << path << ": " << jobs.size() << " jobs, ";
+		if (sim_s > 0)
+			std::cout << jobs.size() / sim_s << " jobs per simulated second, ";
+		else
+			std::cout << "no simulated time (untimed), ";
+		std::cout << jobs.size() / host_s << " jobs per host second" << std::endl;
+	}
+};
+
+template <int W, int DATA_I, int ANGLE_I, unsigned int ITER>
+constexpr unsigned int PEBench<W, DATA_I, ANGLE_I, ITER>::DCT_LENGTHS[];
+
+template <int W, int DATA_I, int ANGLE_I, unsigned int ITER>
+int run_bench(const BenchOptions &opt) {
+	CordicPE<W, DATA_I, ANGLE_I, ITER> pe("PE", opt.pe_pipelined, sc_core::sc_time(opt.pe_clock_ns, sc_core::SC_NS),
+	                                      opt.pe_lt);
+	PEBench<W, DATA_I, ANGLE_I, ITER> bench("PEBench", pe, opt);
+	sc_core::sc_start();
+	return bench.status;
+}
+
+int sc_main(int argc, char **argv) {
+	BenchOptions opt;
+	opt.parse(argc, argv);
+
+	if (opt.pe_lt)
+		tlm::tlm_global_quantum::instance().set(sc_core::sc_time(1, sc_core::SC_US));
+
+	if (opt.precision == "lp")
+		return run_bench<12, 4, 9, 5>(opt);
+	if (opt.precision == "hp")
+		return run_bench<24, 8, 9, 16>(opt);
+	return run_bench<16, 8, 9, 7>(opt);
+}
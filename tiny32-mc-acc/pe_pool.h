@@ -0,0 +1,404 @@
+#ifndef RISCV_VP_PE_POOL_H
+#define RISCV_VP_PE_POOL_H
+
+#include <systemc>
+
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/simple_target_socket.h>
+
+#include "defines.h"
+#include "perf_counters.h"
+
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Front end sharing the PEs between all bus masters. Every hart has a
+// port; jobs written to any port go into one submit queue, and a dispatch
+// lane per PE takes the next queued job as soon as its PE has room. The
+// result returns, tagged with the job ID chosen by the submitter, to the
+// completion queue of the port the job came from, so the PEs stay busy
+// however the work is split between the harts. Jobs of one port that run
+// on different PEs may complete out of order.
+//
+// The lanes reach the PEs over the bus like any other initiator, a PE
+// behind the pool must not be used directly at the same time. Results are
+// read approximately-timed, so a lane waiting for its PE holds neither the
+// bus nor the other lanes.
+struct PEPool : public sc_core::sc_module {
+	tlm_utils::simple_target_socket<PEPool> tsock;
+	tlm_utils::simple_initiator_socket<PEPool> isock;
+
+	enum {
+		PES_ADDR = 0x00,        // number of PEs behind the pool
+		PORTS_ADDR = 0x04,      // number of ports
+		QUEUED_ADDR = 0x08,     // jobs waiting for a PE
+		IN_FLIGHT_ADDR = 0x0c,  // jobs issued to a PE and not completed yet
+		PERF_ADDR = 0x100,
+		PORT_BASE_ADDR = 0x1000,
+		PORT_STRIDE = 0x40,
+	};
+
+	// Port registers, offsets from PORT_BASE_ADDR + port * PORT_STRIDE.
+	// Writing Z submits {TAG, A, B, Z} in the port's MODE, so a 16-byte
+	// write at TAG (from a hart or the DMA) is one job. Reading RESULT_TAG
+	// pops the next completed job of the port and latches its outputs in
+	// RESULT_A/B/Z, a 16-byte read at RESULT_TAG returns the whole result.
+	enum {
+		PORT_TAG = 0x00,
+		PORT_A = 0x04,
+		PORT_B = 0x08,
+		PORT_Z = 0x0c,
+		PORT_MODE = 0x10,    // PE_MODE_ROTATION or PE_MODE_VECTORING
+		PORT_STATUS = 0x14,  // bits 15..0 completed, bits 31..16 outstanding jobs
+		PORT_RESULT_TAG = 0x20,
+		PORT_RESULT_A = 0x24,
+		PORT_RESULT_B = 0x28,
+		PORT_RESULT_Z = 0x2c,
+	};
+
+	// jobs a port may have outstanding, i.e. submitted and not popped; a
+	// further submit stalls the writer until a result is popped
+	static const unsigned PORT_DEPTH = 64;
+	// RESULT_TAG of a port without outstanding jobs
+	static const uint32_t NO_JOB = 0xffffffff;
+
+	struct job {
+		unsigned port = 0;
+		uint32_t tag = 0;
+		uint32_t mode = PE_MODE_ROTATION;
+		uint32_t abz[3] = {};  // operands, then results, as raw float words
+
+		friend std::ostream &operator<<(std::ostream &os, const job &j) {
+			return os << "job " << j.tag << " of port " << j.port;
+		}
+	};
+
+	struct port {
+		uint32_t tag = 0;
+		uint32_t a = 0;
+		uint32_t b = 0;
+		uint32_t mode = PE_MODE_ROTATION;
+		uint32_t result[4] = {NO_JOB, 0, 0, 0};
+		unsigned outstanding = 0;
+		std::deque<job> done;
+	};
+
+	// Feeds one PE: issues queued jobs while fewer than the window are in
+	// the PE and collects the results in issue order, which is the order
+	// the PE returns them in.
+	struct Lane : public sc_core::sc_module {
+		PEPool &pool;
+		uint64_t pe_addr;
+		sc_core::sc_fifo<job> issued;
+		uint32_t mode = PE_MODE_ROTATION;  // last mode written to the PE
+		uint64_t jobs = 0;
+
+		SC_HAS_PROCESS(Lane);
+
+		Lane(sc_core::sc_module_name name, PEPool &pool, uint64_t pe_addr, unsigned window)
+		    : sc_module(name), pool(pool), pe_addr(pe_addr), issued(window) {
+			SC_THREAD(feed);
+			SC_THREAD(collect);
+		}
+
+		void feed() {
+			while (true) {
+				job j = pool.next_job();
+				issued.write(j);
+				if (j.mode != mode) {
+					mode = j.mode;
+					pool.do_transaction(tlm::TLM_WRITE_COMMAND, pe_addr + PE_MODE_ADDR, (uint8_t *)&mode, 4);
+				}
+				pool.do_transaction(tlm::TLM_WRITE_COMMAND, pe_addr + PE_INPUT_A_ADDR, (uint8_t *)j.abz, 12);
+			}
+		}
+
+		void collect() {
+			while (true) {
+				job j = issued.read();
+				pool.do_at_transaction(tlm::TLM_READ_COMMAND, pe_addr + PE_OUTPUT_A_ADDR, (uint8_t *)j.abz, 12);
+				jobs++;
+				pool.complete(j);
+			}
+		}
+	};
+
+	std::vector<std::unique_ptr<Lane>> lanes;
+	std::vector<port> ports;
+	std::deque<job> queue;
+	unsigned in_flight = 0;
+	sc_core::sc_event job_event;     // a job was queued
+	sc_core::sc_event result_event;  // a job completed
+	sc_core::sc_event room_event;    // a result was popped
+
+	// guest visible counters at PERF_ADDR in 10 ns cycles: busy while any
+	// job is queued or in a PE, one op per completed job, 24 bytes per job,
+	// input-full/output-empty are the time submitters waited for port room
+	// and readers for results
+	PerfCounters perf;
+
+	// pe_addrs are the bus addresses of the PEs, window the number of jobs
+	// a lane keeps in its PE (enough to fill a pipelined PE)
+	PEPool(sc_core::sc_module_name, const std::vector<uint64_t> &pe_addrs, unsigned num_ports, unsigned window = 4)
+	    : ports(num_ports) {
+		assert(!pe_addrs.empty() && num_ports > 0 && window > 0);
+
+		tsock.register_b_transport(this, &PEPool::transport);
+		isock.register_nb_transport_bw(this, &PEPool::nb_transport_bw);
+
+		for (unsigned i = 0; i < pe_addrs.size(); ++i) {
+			std::string name = "lane" + std::to_string(i);
+			lanes.emplace_back(new Lane(name.c_str(), *this, pe_addrs[i], window));
+		}
+	}
+
+	void show_stats() const {
+		std::cout << name() << ": " << lanes.size() << " PEs, " << ports.size() << " ports" << std::endl;
+		for (auto &lane : lanes) {
+			std::cout << "  " << lane->basename() << " (PE at 0x" << std::hex << lane->pe_addr << std::dec
+			          << ") jobs = " << lane->jobs << std::endl;
+		}
+	}
+
+	uint64_t jobs() const {
+		uint64_t n = 0;
+		for (auto &lane : lanes)
+			n += lane->jobs;
+		return n;
+	}
+
+	job next_job() {
+		while (queue.empty())
+			sc_core::wait(job_event);
+		job j = queue.front();
+		queue.pop_front();
+		in_flight++;
+		return j;
+	}
+
+	void complete(const job &j) {
+		in_flight--;
+		ports[j.port].done.push_back(j);
+		perf.op();
+		perf.moved(24);
+		if (queue.empty() && in_flight == 0)
+			perf.busy_end();
+		result_event.notify();
+	}
+
+	void sync(sc_core::sc_time &delay) {
+		if (delay != sc_core::SC_ZERO_TIME) {
+			sc_core::wait(delay);
+			delay = sc_core::SC_ZERO_TIME;
+		}
+	}
+
+	void submit(unsigned p, uint32_t z, sc_core::sc_time &delay) {
+		port &pt = ports[p];
+		if (pt.outstanding >= PORT_DEPTH) {
+			sync(delay);
+			sc_core::sc_time start = sc_core::sc_time_stamp();
+			while (pt.outstanding >= PORT_DEPTH)
+				sc_core::wait(room_event);
+			perf.stall_in(sc_core::sc_time_stamp() - start);
+		}
+		job j;
+		j.port = p;
+		j.tag = pt.tag;
+		j.mode = pt.mode;
+		j.abz[0] = pt.a;
+		j.abz[1] = pt.b;
+		j.abz[2] = z;
+		if (queue.empty() && in_flight == 0)
+			perf.busy_begin();
+		pt.outstanding++;
+		queue.push_back(j);
+		job_event.notify();
+	}
+
+	void pop(unsigned p, sc_core::sc_time &delay) {
+		port &pt = ports[p];
+		if (pt.outstanding == 0) {
+			pt.result[0] = NO_JOB;
+			pt.result[1] = pt.result[2] = pt.result[3] = 0;
+			return;
+		}
+		if (pt.done.empty()) {
+			sync(delay);
+			sc_core::sc_time start = sc_core::sc_time_stamp();
+			while (pt.done.empty())
+				sc_core::wait(result_event);
+			perf.stall_out(sc_core::sc_time_stamp() - start);
+		}
+		const job &j = pt.done.front();
+		pt.result[0] = j.tag;
+		pt.result[1] = j.abz[0];
+		pt.result[2] = j.abz[1];
+		pt.result[3] = j.abz[2];
+		pt.done.pop_front();
+		pt.outstanding--;
+		room_event.notify();
+	}
+
+	uint32_t read_word(uint64_t addr, sc_core::sc_time &delay) {
+		if (addr >= PERF_ADDR && addr < PERF_ADDR + PERF_BLOCK_SIZE)
+			return perf.read(addr - PERF_ADDR);
+		if (addr < PORT_BASE_ADDR) {
+			switch (addr) {
+				case PES_ADDR:
+					return lanes.size();
+				case PORTS_ADDR:
+					return ports.size();
+				case QUEUED_ADDR:
+					return queue.size();
+				case IN_FLIGHT_ADDR:
+					return in_flight;
+			}
+			assert(false && "access to non-mapped PE pool register");
+		}
+
+		unsigned p = (addr - PORT_BASE_ADDR) / PORT_STRIDE;
+		assert(p < ports.size());
+		port &pt = ports[p];
+		switch ((addr - PORT_BASE_ADDR) % PORT_STRIDE) {
+			case PORT_TAG:
+				return pt.tag;
+			case PORT_A:
+				return pt.a;
+			case PORT_B:
+				return pt.b;
+			case PORT_MODE:
+				return pt.mode;
+			case PORT_STATUS:
+				return (pt.outstanding << 16) | pt.done.size();
+			case PORT_RESULT_TAG:
+				pop(p, delay);
+				return pt.result[0];
+			case PORT_RESULT_A:
+				return pt.result[1];
+			case PORT_RESULT_B:
+				return pt.result[2];
+			case PORT_RESULT_Z:
+				return pt.result[3];
+		}
+		assert(false && "access to non-mapped PE pool port register");
+		return 0;
+	}
+
+	void write_word(uint64_t addr, uint32_t value, sc_core::sc_time &delay) {
+		if (addr >= PERF_ADDR && addr < PERF_ADDR + PERF_BLOCK_SIZE) {
+			perf.write(addr - PERF_ADDR, value);
+			return;
+		}
+		assert(addr >= PORT_BASE_ADDR && "PE pool registers are read only");
+
+		unsigned p = (addr - PORT_BASE_ADDR) / PORT_STRIDE;
+		assert(p < ports.size());
+		port &pt = ports[p];
+		switch ((addr - PORT_BASE_ADDR) % PORT_STRIDE) {
+			case PORT_TAG:
+				pt.tag = value;
+				break;
+			case PORT_A:
+				pt.a = value;
+				break;
+			case PORT_B:
+				pt.b = value;
+				break;
+			case PORT_Z:
+				submit(p, value, delay);
+				break;
+			case PORT_MODE:
+				pt.mode = value;
+				break;
+			default:
+				assert(false && "write to read only PE pool port register");
+		}
+	}
+
+	// Bursts are split into consecutive 32-bit register accesses. Register
+	// accesses take no time, the initiator only synchronizes when it has
+	// to wait for port room or a result.
+	void transport(tlm::tlm_generic_payload &trans, sc_core::sc_time &delay) {
+		auto addr = trans.get_address();
+		auto cmd = trans.get_command();
+		auto len = trans.get_data_length();
+		auto ptr = trans.get_data_ptr();
+
+		assert(len > 0 && len % 4 == 0);  // NOTE: only whole registers
+
+		for (unsigned i = 0; i < len; i += 4) {
+			if (cmd == tlm::TLM_READ_COMMAND) {
+				*((uint32_t *)(ptr + i)) = read_word(addr + i, delay);
+			} else if (cmd == tlm::TLM_WRITE_COMMAND) {
+				write_word(addr + i, *((uint32_t *)(ptr + i)), delay);
+			} else {
+				assert(false && "unsupported tlm command for PE pool access");
+			}
+		}
+		trans.set_response_status(tlm::TLM_OK_RESPONSE);
+	}
+
+	void do_transaction(tlm::tlm_command cmd, uint64_t addr, uint8_t *data, unsigned num_bytes) {
+		sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+
+		tlm::tlm_generic_payload trans;
+		trans.set_command(cmd);
+		trans.set_address(addr);
+		trans.set_data_ptr(data);
+		trans.set_data_length(num_bytes);
+
+		isock->b_transport(trans, delay);
+
+		if (delay != sc_core::SC_ZERO_TIME)
+			sc_core::wait(delay);
+	}
+
+	// AT base protocol access, the calling lane waits for BEGIN_RESP
+	void do_at_transaction(tlm::tlm_command cmd, uint64_t addr, uint8_t *data, unsigned num_bytes) {
+		sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+
+		tlm::tlm_generic_payload trans;
+		trans.set_command(cmd);
+		trans.set_address(addr);
+		trans.set_data_ptr(data);
+		trans.set_data_length(num_bytes);
+
+		sc_core::sc_event response;
+		responses[&trans] = &response;
+
+		tlm::tlm_phase phase = tlm::BEGIN_REQ;
+		auto status = isock->nb_transport_fw(trans, phase, delay);
+		if (status == tlm::TLM_UPDATED && phase == tlm::BEGIN_RESP) {
+			phase = tlm::END_RESP;
+			isock->nb_transport_fw(trans, phase, delay);
+		} else if (status != tlm::TLM_COMPLETED) {
+			sc_core::wait(response);
+			delay = sc_core::SC_ZERO_TIME;
+		}
+		responses.erase(&trans);
+
+		if (delay != sc_core::SC_ZERO_TIME)
+			sc_core::wait(delay);
+	}
+
+	tlm::tlm_sync_enum nb_transport_bw(tlm::tlm_generic_payload &trans, tlm::tlm_phase &phase,
+	                                   sc_core::sc_time &delay) {
+		if (phase != tlm::BEGIN_RESP)
+			return tlm::TLM_ACCEPTED;
+		auto it = responses.find(&trans);
+		assert(it != responses.end());
+		it->second->notify(delay);
+		return tlm::TLM_COMPLETED;
+	}
+
+   private:
+	// lane transactions waiting for BEGIN_RESP
+	std::map<tlm::tlm_generic_payload *, sc_core::sc_event *> responses;
+};
+
+#endif
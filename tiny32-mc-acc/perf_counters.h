@@ -0,0 +1,148 @@
+#ifndef RISCV_VP_PERF_COUNTERS_H
+#define RISCV_VP_PERF_COUNTERS_H
+
+#include <systemc>
+
+#include <cstdint>
+
+// Register block of the peripheral performance counters, offsets from the
+// block base. Time based counters count clock cycles of the owning
+// peripheral, all counters read their low 32 bits.
+enum {
+	PERF_CTRL = 0x00,
+	PERF_BUSY = 0x04,       // cycles with work in flight
+	PERF_IDLE = 0x08,       // counted cycles without work
+	PERF_IN_FULL = 0x0c,    // cycles a bus write waited for a full input fifo
+	PERF_OUT_EMPTY = 0x10,  // cycles a bus read waited for an empty output fifo
+	PERF_OPS = 0x14,        // completed operations
+	PERF_BYTES = 0x18,      // bytes moved
+	PERF_BLOCK_SIZE = 0x20,
+};
+
+// PERF_CTRL bits: RESET zeroes all counters (self clearing), FREEZE stops
+// counting while set
+enum {
+	PERF_RESET = 0x1,
+	PERF_FREEZE = 0x2,
+};
+
+class PerfCounters {
+   public:
+	explicit PerfCounters(sc_core::sc_time clock = sc_core::sc_time(10, sc_core::SC_NS)) : clock(clock) {}
+
+	void set_clock(sc_core::sc_time clock) {
+		this->clock = clock;
+	}
+
+	// Busy periods may nest, e.g. a batch running while the pipeline is
+	// filled, the peripheral is busy while any of them is open.
+	void busy_begin() {
+		if (depth++ == 0)
+			busy_since = now();
+	}
+
+	void busy_end() {
+		if (--depth == 0 && !frozen)
+			busy += now() - busy_since;
+	}
+
+	void stall_in(const sc_core::sc_time &t) {
+		if (!frozen)
+			in_full += t;
+	}
+
+	void stall_out(const sc_core::sc_time &t) {
+		if (!frozen)
+			out_empty += t;
+	}
+
+	void op() {
+		if (!frozen)
+			ops++;
+	}
+
+	void moved(uint64_t n) {
+		if (!frozen)
+			bytes += n;
+	}
+
+	uint32_t read(unsigned offset) const {
+		switch (offset) {
+			case PERF_CTRL:
+				return frozen ? PERF_FREEZE : 0;
+			case PERF_BUSY:
+				return cycles(busy_time());
+			case PERF_IDLE:
+				return cycles(elapsed() - busy_time());
+			case PERF_IN_FULL:
+				return cycles(in_full);
+			case PERF_OUT_EMPTY:
+				return cycles(out_empty);
+			case PERF_OPS:
+				return (uint32_t)ops;
+			case PERF_BYTES:
+				return (uint32_t)bytes;
+			default:
+				return 0;
+		}
+	}
+
+	void write(unsigned offset, uint32_t value) {
+		if (offset != PERF_CTRL)
+			return;
+		if (value & PERF_RESET)
+			reset();
+		bool freeze = value & PERF_FREEZE;
+		if (freeze && !frozen) {
+			counted = elapsed();
+			busy = busy_time();
+			frozen = true;
+		} else if (!freeze && frozen) {
+			since = now();
+			busy_since = now();
+			frozen = false;
+		}
+	}
+
+   private:
+	sc_core::sc_time clock;
+	bool frozen = false;
+	unsigned depth = 0;
+	sc_core::sc_time since;       // counting (re)started
+	sc_core::sc_time counted;     // counted time before since
+	sc_core::sc_time busy_since;  // start of the open busy period
+	sc_core::sc_time busy;        // closed busy periods
+	sc_core::sc_time in_full;
+	sc_core::sc_time out_empty;
+	uint64_t ops = 0;
+	uint64_t bytes = 0;
+
+	static sc_core::sc_time now() {
+		return sc_core::sc_time_stamp();
+	}
+
+	void reset() {
+		since = now();
+		busy_since = now();
+		counted = sc_core::SC_ZERO_TIME;
+		busy = sc_core::SC_ZERO_TIME;
+		in_full = sc_core::SC_ZERO_TIME;
+		out_empty = sc_core::SC_ZERO_TIME;
+		ops = 0;
+		bytes = 0;
+	}
+
+	sc_core::sc_time elapsed() const {
+		return frozen ? counted : counted + (now() - since);
+	}
+
+	sc_core::sc_time busy_time() const {
+		return (frozen || depth == 0) ? busy : busy + (now() - busy_since);
+	}
+
+	uint32_t cycles(const sc_core::sc_time &t) const {
+		return (uint32_t)(uint64_t)(t / clock);
+	}
+};
+
+#endif
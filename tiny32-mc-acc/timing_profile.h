@@ -0,0 +1,272 @@
+#ifndef RISCV_VP_TIMING_PROFILE_H
+#define RISCV_VP_TIMING_PROFILE_H
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <systemc>
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// PE, DMA and bus timing of the platform. A profile file holds one
+// "key = value" per line, '#' starts a comment, keys left out keep their
+// value, e.g.
+//
+//   # slow PE behind a wide DMA
+//   pe_output_ns = 180
+//   dma_beat_width = 8
+//   dma_beat_ns = 5
+struct TimingProfile {
+	std::string name = "default";
+	double pe_clock_ns = 10;     // pipelined PE, every access takes one period
+	double pe_input_ns = 30;     // untimed PE, INPUT_A and PACKED_AB writes
+	double pe_output_ns = 90;    // untimed PE, OUTPUT_A and PACKED_OUT_AB reads
+	double pe_register_ns = 10;  // untimed PE, every other register
+	double dma_start_ns = 10;    // from the OP or DESC write to the transfer
+	double dma_beat_width = 4;   // bytes per DMA bus beat
+	double dma_beat_ns = 0;
+	double dma_burst_ns = 0;
+	double bus_ns = 0;  // added to every bus transaction
+
+	// throws std::runtime_error naming the file and line of a bad entry
+	void load(const std::string &file) {
+		std::map<std::string, double *> keys = {
+		    {"pe_clock_ns", &pe_clock_ns},       {"pe_input_ns", &pe_input_ns},   {"pe_output_ns", &pe_output_ns},
+		    {"pe_register_ns", &pe_register_ns}, {"dma_start_ns", &dma_start_ns}, {"dma_beat_width", &dma_beat_width},
+		    {"dma_beat_ns", &dma_beat_ns},       {"dma_burst_ns", &dma_burst_ns}, {"bus_ns", &bus_ns},
+		};
+
+		std::ifstream in(file);
+		if (!in)
+			throw std::runtime_error("cannot open timing profile " + file);
+
+		std::string line;
+		for (unsigned n = 1; std::getline(in, line); ++n) {
+			line = line.substr(0, line.find('#'));
+			auto eq = line.find('=');
+			std::istringstream key_in(line.substr(0, eq));
+			std::string key, rest;
+			if (!(key_in >> key))
+				continue;
+
+			std::string where = file + ":" + std::to_string(n) + ": ";
+			auto it = keys.find(key);
+			if (it == keys.end())
+				throw std::runtime_error(where + "unknown key " + key);
+			if (eq == std::string::npos)
+				throw std::runtime_error(where + "expected " + key + " = value");
+			std::istringstream value_in(line.substr(eq + 1));
+			double value;
+			if (!(value_in >> value) || (value_in >> rest) || value < 0)
+				throw std::runtime_error(where + "bad value for " + key);
+			*it->second = value;
+		}
+		if (dma_beat_width < 1)
+			throw std::runtime_error(file + ": dma_beat_width must be at least 1");
+		name = file;
+	}
+
+	static sc_core::sc_time ns(double v) {
+		return sc_core::sc_time(v, sc_core::SC_NS);
+	}
+};
+
+// Runs the VP once per profile as parallel host processes, with the
+// command line of this one minus the sweep options plus --timing-profile,
+// and gathers the "profile,simulated ns,instructions" line each run
+// appends to its result file. Every run works in a directory of its own,
+// <dir>/<n>-<profile name>, with copies of the inputs, so the files the
+// guest program writes and the run's vp.log and timing.result stay apart.
+// Arguments naming an existing file are passed as absolute paths.
+struct TimingSweep {
+	std::vector<std::string> profiles;
+	unsigned jobs = 1;
+	std::string csv;
+	std::string dir = "sweep_runs";
+	std::vector<std::string> inputs;  // copied into every run directory
+
+	struct result {
+		int exit = -1;
+		double sim_ns = 0;
+		unsigned long long instret = 0;
+	};
+
+	// options the parent consumes, each takes one value
+	static bool sweep_option(const std::string &arg) {
+		for (const char *opt : {"--timing-sweep", "--sweep-jobs", "--sweep-csv", "--sweep-dir", "--sweep-inputs",
+		                        "--timing-profile", "--timing-result"}) {
+			std::string o(opt);
+			if (arg == o || arg.compare(0, o.size() + 1, o + "=") == 0)
+				return true;
+		}
+		return false;
+	}
+
+	int run(int argc, char **argv) {
+		for (auto &p : profiles) {
+			try {
+				TimingProfile().load(p);
+			} catch (std::runtime_error &e) {
+				std::cerr << "Error in timing sweep: " << e.what() << std::endl;
+				return -1;
+			}
+		}
+
+		std::vector<std::string> base;
+		for (int i = 0; i < argc; ++i) {
+			std::string arg(argv[i]);
+			if (i > 0 && sweep_option(arg)) {
+				if (arg.find('=') == std::string::npos)
+					++i;
+				continue;
+			}
+			base.push_back(i > 0 && arg[0] != '-' ? absolute(arg) : arg);
+		}
+		base[0] = absolute(base[0]);
+
+		mkdir(dir.c_str(), 0755);
+		std::vector<std::string> run_dirs;
+		for (unsigned i = 0; i < profiles.size(); ++i) {
+			std::string name = profiles[i].substr(profiles[i].rfind('/') + 1);
+			run_dirs.push_back(dir + "/" + std::to_string(i) + "-" + name.substr(0, name.rfind('.')));
+		}
+
+		std::vector<result> results(profiles.size());
+		std::map<pid_t, unsigned> running;
+		unsigned next = 0;
+		while (next < profiles.size() || !running.empty()) {
+			if (next < profiles.size() && running.size() < jobs) {
+				pid_t pid = prepare(run_dirs[next]) ? spawn(base, profiles[next], run_dirs[next]) : -1;
+				if (pid < 0) {
+					std::cerr << "Error in timing sweep: cannot start a run for " << profiles[next] << std::endl;
+					results[next].exit = -1;
+				} else {
+					running[pid] = next;
+				}
+				++next;
+				continue;
+			}
+			int status;
+			pid_t pid = ::wait(&status);
+			if (pid < 0)
+				break;
+			auto it = running.find(pid);
+			if (it == running.end())
+				continue;
+			results[it->second] = collect(run_dirs[it->second], status);
+			running.erase(it);
+		}
+
+		report(std::cout, results);
+		if (!csv.empty()) {
+			std::ofstream out(csv);
+			out << "profile,exit,sim_ns,instret" << std::endl;
+			for (unsigned i = 0; i < profiles.size(); ++i)
+				out << profiles[i] << "," << results[i].exit << "," << results[i].sim_ns << "," << results[i].instret
+				    << std::endl;
+		}
+
+		for (auto &r : results) {
+			if (r.exit != 0)
+				return 1;
+		}
+		return 0;
+	}
+
+	// path that stays valid once a run changed into its directory, arg
+	// itself unless it names an existing file
+	static std::string absolute(const std::string &arg) {
+		char path[PATH_MAX];
+		if (arg.find('/') == std::string::npos && access(arg.c_str(), F_OK) != 0)
+			return arg;  // a command found in PATH or not a file
+		if (!realpath(arg.c_str(), path))
+			return arg;
+		return path;
+	}
+
+	// creates the run directory with fresh copies of the inputs
+	bool prepare(const std::string &run_dir) {
+		mkdir(run_dir.c_str(), 0755);
+		std::remove((run_dir + "/timing.result").c_str());
+		for (auto &input : inputs) {
+			std::ifstream in(input, std::ios::binary);
+			std::ofstream out(run_dir + "/" + input.substr(input.rfind('/') + 1), std::ios::binary);
+			if (!in || !(out << in.rdbuf())) {
+				std::cerr << "Error in timing sweep: cannot copy " << input << " to " << run_dir << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	pid_t spawn(const std::vector<std::string> &base, const std::string &profile, const std::string &run_dir) {
+		std::vector<std::string> args(base);
+		args.insert(args.end(), {"--timing-profile", absolute(profile), "--timing-result", "timing.result"});
+
+		pid_t pid = fork();
+		if (pid != 0)
+			return pid;
+
+		if (chdir(run_dir.c_str()) != 0)
+			_exit(127);
+		int fd = open("vp.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd >= 0) {
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+			close(fd);
+		}
+		std::vector<char *> c_args;
+		for (auto &a : args)
+			c_args.push_back(const_cast<char *>(a.c_str()));
+		c_args.push_back(nullptr);
+		execvp(c_args[0], c_args.data());
+		_exit(127);
+	}
+
+	result collect(const std::string &run_dir, int status) {
+		result r;
+		r.exit = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+		std::ifstream in(run_dir + "/timing.result");
+		std::string line;
+		if (std::getline(in, line)) {
+			// the profile name may contain commas, the numbers do not
+			auto instret_at = line.rfind(',');
+			auto sim_at = line.rfind(',', instret_at - 1);
+			if (instret_at != std::string::npos && sim_at != std::string::npos) {
+				r.sim_ns = std::stod(line.substr(sim_at + 1, instret_at - sim_at - 1));
+				r.instret = std::stoull(line.substr(instret_at + 1));
+			}
+		}
+		if (r.exit == 0 && r.sim_ns == 0)
+			r.exit = -1;  // finished without a result
+		return r;
+	}
+
+	void report(std::ostream &os, const std::vector<result> &results) const {
+		os << "timing sweep:" << std::endl;
+		os << std::left << std::setw(32) << "profile" << std::right << std::setw(6) << "exit" << std::setw(18)
+		   << "sim time [ns]" << std::setw(16) << "instructions" << std::setw(12) << "relative" << std::endl;
+		double first = results.empty() ? 0 : results[0].sim_ns;
+		for (unsigned i = 0; i < profiles.size(); ++i) {
+			const result &r = results[i];
+			os << std::left << std::setw(32) << profiles[i] << std::right << std::setw(6) << r.exit << std::setw(18)
+			   << std::fixed << std::setprecision(0) << r.sim_ns << std::setw(16) << r.instret << std::setw(12)
+			   << std::setprecision(3) << (first > 0 ? r.sim_ns / first : 0.0) << std::endl;
+			os << std::defaultfloat;
+		}
+	}
+};
+
+#endif